@@ -30,29 +30,384 @@
 
 #define CONNMAN_MANAGER_PATH "/"
 #define CONNMAN_MANAGER_INTERFACE CONNMAN_DBUS_NAME ".Manager"
+#define CONNMAN_SERVICE_INTERFACE CONNMAN_DBUS_NAME ".Service"
+
+#define CONNMAN_COUNTER_PATH "/net/connman/network_monitor/counter"
+#define CONNMAN_COUNTER_INTERFACE CONNMAN_DBUS_NAME ".Counter"
+
+/* Notify also after this many kilobytes, not only once per period */
+#define COUNTER_ACCURACY 1024
+#define COUNTER_SAMPLES 8
+
+/* A drop from this close to the 32 bit limit is a wrap, not a reset */
+#define COUNTER_WRAP_MARGIN (256 * 1024 * 1024)
+
+#define LOGIND_DBUS_NAME "org.freedesktop.login1"
+#define LOGIND_MANAGER_PATH "/org/freedesktop/login1"
+#define LOGIND_MANAGER_INTERFACE LOGIND_DBUS_NAME ".Manager"
 
 struct connman_manager {
 	GDBusConnection *connection;
 	guint connman_watch;
 	guint property_changed_watch;
-	connman_property_changed_cb property_changed_cb;
-	void *property_user_data;
+	guint prepare_for_sleep_watch;
+	guint services_changed_watch;
+	guint service_changed_watch;
+	const struct connman_manager_callbacks *callbacks;
+	void *user_data;
 	gboolean connman_running;
+	gboolean refreshing;
 	GCancellable *pending;
+	GHashTable *services;
+	char *first_service;
+	char *default_service;
+	char *default_ipv4;
+	char *default_ipv6;
+	GVariant *default_proxy;
+	int default_strength;
+	char *connman_owner;
+	GDBusNodeInfo *counter_info;
+	guint counter_id;
+	unsigned int counter_period;
+	GHashTable *counter_services;
 };
 
-static gboolean update_property(struct connman_manager *manager,
-				const char *property,
-				void *value, void *user_data)
+struct connman_service {
+	gboolean connected;
+	int strength;
+	char *ipv4_network;
+	char *ipv6_network;
+	GVariant *proxy;
+};
+
+enum {
+	COUNTER_HOME = 0,
+	COUNTER_ROAMING,
+	COUNTER_MAX,
+};
+
+struct counter_sample {
+	gint64 time;
+	guint64 rx_bytes;
+	guint64 tx_bytes;
+};
+
+struct counter_service {
+	gboolean rx_seen[COUNTER_MAX];
+	gboolean tx_seen[COUNTER_MAX];
+	guint32 rx_bytes[COUNTER_MAX];
+	guint32 tx_bytes[COUNTER_MAX];
+	guint64 rx_total;
+	guint64 tx_total;
+	struct counter_sample samples[COUNTER_SAMPLES];
+	unsigned int next;
+	unsigned int count;
+};
+
+static const char counter_xml[] =
+	"<node>"
+	"  <interface name='" CONNMAN_COUNTER_INTERFACE "'>"
+	"    <method name='Release'/>"
+	"    <method name='Usage'>"
+	"      <arg type='o' name='service' direction='in'/>"
+	"      <arg type='a{sv}' name='home' direction='in'/>"
+	"      <arg type='a{sv}' name='roaming' direction='in'/>"
+	"    </method>"
+	"  </interface>"
+	"</node>";
+
+#define HAS_CALLBACK(manager, name) \
+	((manager)->callbacks != NULL && (manager)->callbacks->name != NULL)
+
+static void update_state(struct connman_manager *manager, const char *state)
+{
+	DBG("state %s", state);
+
+	if (HAS_CALLBACK(manager, state_changed))
+		manager->callbacks->state_changed(state, manager->user_data);
+}
+
+static void update_stale(struct connman_manager *manager, gboolean stale)
+{
+	DBG("stale %d", stale);
+
+	if (HAS_CALLBACK(manager, stale_changed))
+		manager->callbacks->stale_changed(stale, manager->user_data);
+}
+
+static void service_free(gpointer data)
+{
+	struct connman_service *service = data;
+
+	g_free(service->ipv4_network);
+	g_free(service->ipv6_network);
+
+	if (service->proxy != NULL)
+		g_variant_unref(service->proxy);
+
+	g_free(service);
+}
+
+/* Kept as address/netmask for IPv4 and address/prefix length for IPv6 */
+static void update_network(char **network, GVariant *dict)
+{
+	const char *address = NULL, *netmask = NULL;
+	guint8 prefixlen;
+
+	g_free(*network);
+	*network = NULL;
+
+	if (g_variant_lookup(dict, "Address", "&s", &address) == FALSE)
+		return;
+
+	if (g_variant_lookup(dict, "Netmask", "&s", &netmask) == TRUE)
+		*network = g_strdup_printf("%s/%s", address, netmask);
+	else if (g_variant_lookup(dict, "PrefixLength", "y",
+							&prefixlen) == TRUE)
+		*network = g_strdup_printf("%s/%u", address, prefixlen);
+	else
+		*network = g_strdup(address);
+}
+
+static void service_update(struct connman_service *service,
+				const char *key, GVariant *value)
+{
+	if (g_str_equal(key, "State") == TRUE) {
+		const char *state = g_variant_get_string(value, NULL);
+
+		service->connected = g_strcmp0(state, "ready") == 0 ||
+					g_strcmp0(state, "online") == 0;
+	} else if (g_str_equal(key, "Strength") == TRUE)
+		service->strength = g_variant_get_byte(value);
+	else if (g_str_equal(key, "IPv4") == TRUE)
+		update_network(&service->ipv4_network, value);
+	else if (g_str_equal(key, "IPv6") == TRUE)
+		update_network(&service->ipv6_network, value);
+	else if (g_str_equal(key, "Proxy") == TRUE) {
+		if (service->proxy != NULL)
+			g_variant_unref(service->proxy);
+
+		service->proxy = g_variant_ref(value);
+	}
+}
+
+static struct connman_service *service_lookup(struct connman_manager *manager,
+						const char *path)
+{
+	struct connman_service *service;
+
+	service = g_hash_table_lookup(manager->services, path);
+	if (service != NULL)
+		return service;
+
+	service = g_new0(struct connman_service, 1);
+	service->strength = -1;
+
+	g_hash_table_insert(manager->services, g_strdup(path), service);
+
+	return service;
+}
+
+static void update_default_service(struct connman_manager *manager,
+					struct connman_service *service)
+{
+	const char *path = NULL, *ipv4 = NULL, *ipv6 = NULL;
+
+	if (service != NULL) {
+		path = manager->first_service;
+		ipv4 = service->ipv4_network;
+		ipv6 = service->ipv6_network;
+	}
+
+	if (g_strcmp0(path, manager->default_service) == 0 &&
+			g_strcmp0(ipv4, manager->default_ipv4) == 0 &&
+			g_strcmp0(ipv6, manager->default_ipv6) == 0)
+		return;
+
+	DBG("service %s ipv4 %s ipv6 %s", path, ipv4, ipv6);
+
+	g_free(manager->default_service);
+	g_free(manager->default_ipv4);
+	g_free(manager->default_ipv6);
+	manager->default_service = g_strdup(path);
+	manager->default_ipv4 = g_strdup(ipv4);
+	manager->default_ipv6 = g_strdup(ipv6);
+
+	if (HAS_CALLBACK(manager, default_service_changed))
+		manager->callbacks->default_service_changed(path, ipv4, ipv6,
+							manager->user_data);
+}
+
+static void update_default_proxy(struct connman_manager *manager,
+					struct connman_service *service)
+{
+	GVariant *proxy = service != NULL ? service->proxy : NULL;
+
+	if (proxy == manager->default_proxy)
+		return;
+
+	if (proxy != NULL && manager->default_proxy != NULL &&
+			g_variant_equal(proxy, manager->default_proxy) == TRUE)
+		return;
+
+	if (manager->default_proxy != NULL)
+		g_variant_unref(manager->default_proxy);
+
+	manager->default_proxy = proxy != NULL ? g_variant_ref(proxy) : NULL;
+
+	if (HAS_CALLBACK(manager, proxy_changed))
+		manager->callbacks->proxy_changed(proxy, manager->user_data);
+}
+
+static void update_default(struct connman_manager *manager)
+{
+	struct connman_service *service = NULL;
+	int strength;
+
+	/* ConnMan keeps the connected services first in its list */
+	if (manager->first_service != NULL)
+		service = g_hash_table_lookup(manager->services,
+						manager->first_service);
+	if (service != NULL && service->connected == FALSE)
+		service = NULL;
+
+	update_default_service(manager, service);
+	update_default_proxy(manager, service);
+
+	strength = service != NULL ? service->strength : -1;
+	if (strength != manager->default_strength) {
+		manager->default_strength = strength;
+		if (HAS_CALLBACK(manager, strength_changed))
+			manager->callbacks->strength_changed(strength,
+							manager->user_data);
+	}
+}
+
+static void services_changed(struct connman_manager *manager,
+				GVariant *changed)
+{
+	struct connman_service *service;
+	GVariantIter iter, props;
+	GVariant *dict, *value;
+	const char *path, *key;
+	gboolean first = TRUE;
+
+	g_variant_iter_init(&iter, changed);
+
+	while (g_variant_iter_loop(&iter, "(&o@a{sv})", &path, &dict)) {
+		/* Every service is listed in order, changed or not */
+		if (first == TRUE) {
+			g_free(manager->first_service);
+			manager->first_service = g_strdup(path);
+			first = FALSE;
+		}
+
+		service = service_lookup(manager, path);
+
+		g_variant_iter_init(&props, dict);
+		while (g_variant_iter_loop(&props, "{&sv}", &key, &value))
+			service_update(service, key, value);
+	}
+}
+
+static void refresh_done(struct connman_manager *manager)
+{
+	g_object_unref(manager->pending);
+	manager->pending = NULL;
+
+	if (manager->refreshing == TRUE) {
+		manager->refreshing = FALSE;
+		update_stale(manager, FALSE);
+	}
+}
+
+/* Forget the traffic of services that are gone */
+static void prune_counters(struct connman_manager *manager)
+{
+	GHashTableIter iter;
+	gpointer key;
+
+	if (manager->counter_services == NULL)
+		return;
+
+	g_hash_table_iter_init(&iter, manager->counter_services);
+	while (g_hash_table_iter_next(&iter, &key, NULL) == TRUE) {
+		if (g_hash_table_contains(manager->services, key) == FALSE)
+			g_hash_table_iter_remove(&iter);
+	}
+}
+
+static void get_services_callback(GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	struct connman_manager *manager = user_data;
+	GDBusMessage *reply;
+	GError *error = NULL;
+	GVariant *services;
+
+	DBG("");
+
+	reply = g_dbus_connection_send_message_with_reply_finish(
+					G_DBUS_CONNECTION(source_object),
+					res, &error);
+	if (reply == NULL && g_error_matches(error, G_IO_ERROR,
+					G_IO_ERROR_CANCELLED) == TRUE) {
+		g_error_free(error);
+		return;
+	}
+
+	if (reply == NULL || g_dbus_message_to_gerror(reply, &error) == TRUE) {
+		DBG("%s", error->message);
+		g_error_free(error);
+		goto error;
+	}
+
+	g_variant_get(g_dbus_message_get_body(reply), "(@a(oa{sv}))",
+			&services);
+
+	g_hash_table_remove_all(manager->services);
+	g_free(manager->first_service);
+	manager->first_service = NULL;
+
+	services_changed(manager, services);
+	update_default(manager);
+	prune_counters(manager);
+
+	g_variant_unref(services);
+
+error:
+	if (reply != NULL)
+		g_object_unref(reply);
+
+	refresh_done(manager);
+}
+
+static int get_services(struct connman_manager *manager)
 {
-	DBG("property %s", property);
+	GDBusMessage *message;
 
-	if (manager == NULL || manager->property_changed_cb == NULL)
-		return FALSE;
+	DBG("");
+
+	message = g_dbus_message_new_method_call(CONNMAN_DBUS_NAME,
+						CONNMAN_MANAGER_PATH,
+						CONNMAN_MANAGER_INTERFACE,
+						"GetServices");
+	if (message == NULL)
+		return -ENOMEM;
+
+	g_dbus_connection_send_message_with_reply(manager->connection,
+						message,
+						G_DBUS_SEND_MESSAGE_FLAGS_NONE,
+						-1,
+						NULL,
+						manager->pending,
+						get_services_callback,
+						manager);
 
-	manager->property_changed_cb(property, value, user_data);
+	g_object_unref(message);
 
-	return TRUE;
+	return 0;
 }
 
 static void get_properties_callback(GObject *source_object,
@@ -69,11 +424,19 @@ static void get_properties_callback(GObject *source_object,
 	DBG("");
 
 	reply = g_dbus_connection_send_message_with_reply_finish(
-					manager->connection, res, &error);
-	if (reply == NULL)
-		goto error;
+					G_DBUS_CONNECTION(source_object),
+					res, &error);
+	if (reply == NULL && g_error_matches(error, G_IO_ERROR,
+					G_IO_ERROR_CANCELLED) == TRUE) {
+		/*
+		 * Whoever cancelled the call owns the cancellable and
+		 * the manager might already be gone.
+		 */
+		g_error_free(error);
+		return;
+	}
 
-	if (error != NULL || g_dbus_message_to_gerror(reply, &error) == TRUE) {
+	if (reply == NULL || g_dbus_message_to_gerror(reply, &error) == TRUE) {
 		DBG("%s", error->message);
 		g_error_free(error);
 		goto error;
@@ -92,17 +455,58 @@ static void get_properties_callback(GObject *source_object,
 
 			state = g_variant_get_string(value, &len);
 
-			update_property(manager, "State", (void *)state,
-					manager->property_user_data);
+			update_state(manager, state);
 		}
 	}
 
+	g_variant_unref(dictionary);
+	g_object_unref(reply);
+
+	/* The services are fetched under the same cancellable */
+	if (get_services(manager) < 0)
+		refresh_done(manager);
+
+	return;
+
 error:
 	if (reply != NULL)
 		g_object_unref(reply);
 
-	g_object_unref(manager->pending);
-	manager->pending = NULL;
+	refresh_done(manager);
+}
+
+static int get_properties(struct connman_manager *manager)
+{
+	GDBusMessage *message;
+
+	DBG("");
+
+	message = g_dbus_message_new_method_call(CONNMAN_DBUS_NAME,
+						CONNMAN_MANAGER_PATH,
+						CONNMAN_MANAGER_INTERFACE,
+						"GetProperties");
+	if (message == NULL)
+		return -ENOMEM;
+
+	/* A reply to an earlier request would carry outdated values */
+	if (manager->pending != NULL) {
+		g_cancellable_cancel(manager->pending);
+		g_object_unref(manager->pending);
+	}
+
+	manager->pending = g_cancellable_new();
+	g_dbus_connection_send_message_with_reply(manager->connection,
+						message,
+						G_DBUS_SEND_MESSAGE_FLAGS_NONE,
+						-1,
+						NULL,
+						manager->pending,
+						get_properties_callback,
+						manager);
+
+	g_object_unref(message);
+
+	return 0;
 }
 
 static void property_changed_signal_cb(GDBusConnection *connection,
@@ -124,13 +528,278 @@ static void property_changed_signal_cb(GDBusConnection *connection,
 		gsize len;
 
 		state = g_variant_get_string(value, &len);
-		update_property(manager, "State", (void *)state,
-				manager->property_user_data);
+		update_state(manager, state);
 	}
 
+	g_variant_unref(value);
 	g_free(key);
 }
 
+static void services_changed_signal_cb(GDBusConnection *connection,
+					const gchar *sender_name,
+					const gchar *object_path,
+					const gchar *interface_name,
+					const gchar *signal_name,
+					GVariant *parameters,
+					gpointer user_data)
+{
+	struct connman_manager *manager = user_data;
+	GVariant *changed, *removed;
+	GVariantIter iter;
+	const char *path;
+
+	g_variant_get(parameters, "(@a(oa{sv})@ao)", &changed, &removed);
+
+	g_variant_iter_init(&iter, removed);
+	while (g_variant_iter_loop(&iter, "&o", &path)) {
+		g_hash_table_remove(manager->services, path);
+
+		/* Rates of a removed service would only decay in the sum */
+		if (manager->counter_services != NULL)
+			g_hash_table_remove(manager->counter_services, path);
+
+		if (g_strcmp0(path, manager->first_service) == 0) {
+			g_free(manager->first_service);
+			manager->first_service = NULL;
+		}
+	}
+
+	services_changed(manager, changed);
+	update_default(manager);
+
+	g_variant_unref(changed);
+	g_variant_unref(removed);
+}
+
+static void service_changed_signal_cb(GDBusConnection *connection,
+					const gchar *sender_name,
+					const gchar *object_path,
+					const gchar *interface_name,
+					const gchar *signal_name,
+					GVariant *parameters,
+					gpointer user_data)
+{
+	struct connman_manager *manager = user_data;
+	struct connman_service *service;
+	GVariant *value;
+	const char *key;
+
+	service = g_hash_table_lookup(manager->services, object_path);
+	if (service == NULL)
+		return;
+
+	g_variant_get(parameters, "(&sv)", &key, &value);
+
+	service_update(service, key, value);
+	update_default(manager);
+
+	g_variant_unref(value);
+}
+
+static void prepare_for_sleep_signal_cb(GDBusConnection *connection,
+					const gchar *sender_name,
+					const gchar *object_path,
+					const gchar *interface_name,
+					const gchar *signal_name,
+					GVariant *parameters,
+					gpointer user_data)
+{
+	struct connman_manager *manager = user_data;
+	gboolean sleeping;
+
+	g_variant_get(parameters, "(b)", &sleeping);
+
+	DBG("%s", sleeping == TRUE ? "suspending" : "resuming");
+
+	if (sleeping == TRUE) {
+		/* A refresh still running for an earlier resume is outdated */
+		if (manager->pending != NULL) {
+			g_cancellable_cancel(manager->pending);
+			g_object_unref(manager->pending);
+			manager->pending = NULL;
+		}
+
+		manager->refreshing = FALSE;
+
+		update_stale(manager, TRUE);
+		return;
+	}
+
+	/*
+	 * ConnMan does not necessarily send anything after resume, so
+	 * fetch the current values. The monitor is told that the values
+	 * are up to date again once the reply has been processed.
+	 */
+	manager->refreshing = TRUE;
+
+	if (get_properties(manager) < 0) {
+		manager->refreshing = FALSE;
+		update_stale(manager, FALSE);
+	}
+}
+
+static void counter_update(struct counter_service *service, int type,
+				GVariant *dict)
+{
+	GVariantIter iter;
+	GVariant *value;
+	const char *key;
+
+	g_variant_iter_init(&iter, dict);
+
+	while (g_variant_iter_loop(&iter, "{&sv}", &key, &value)) {
+		gboolean *seen;
+		guint32 *last;
+		guint64 *total;
+		guint32 bytes;
+
+		if (g_str_equal(key, "RX.Bytes") == TRUE) {
+			seen = &service->rx_seen[type];
+			last = &service->rx_bytes[type];
+			total = &service->rx_total;
+		} else if (g_str_equal(key, "TX.Bytes") == TRUE) {
+			seen = &service->tx_seen[type];
+			last = &service->tx_bytes[type];
+			total = &service->tx_total;
+		} else
+			continue;
+
+		if (g_variant_is_of_type(value, G_VARIANT_TYPE_UINT32) == FALSE)
+			continue;
+
+		bytes = g_variant_get_uint32(value);
+
+		/*
+		 * The first value only sets the base. A smaller value
+		 * means the counter wrapped around or was reset by
+		 * ResetCounters and counts from zero again.
+		 */
+		if (*seen == TRUE) {
+			if (bytes >= *last)
+				*total += bytes - *last;
+			else if (*last >= G_MAXUINT32 - COUNTER_WRAP_MARGIN)
+				*total += (guint32)(bytes - *last);
+			else
+				*total += bytes;
+		}
+
+		*last = bytes;
+		*seen = TRUE;
+	}
+}
+
+static void counter_usage(struct connman_manager *manager,
+				GVariant *parameters)
+{
+	struct counter_service *service;
+	struct counter_sample *sample;
+	GVariant *home, *roaming;
+	const char *path;
+
+	g_variant_get(parameters, "(&o@a{sv}@a{sv})", &path, &home, &roaming);
+
+	DBG("service %s", path);
+
+	service = g_hash_table_lookup(manager->counter_services, path);
+	if (service == NULL) {
+		service = g_new0(struct counter_service, 1);
+		g_hash_table_insert(manager->counter_services,
+					g_strdup(path), service);
+	}
+
+	counter_update(service, COUNTER_HOME, home);
+	counter_update(service, COUNTER_ROAMING, roaming);
+
+	sample = &service->samples[service->next];
+	sample->time = g_get_monotonic_time();
+	sample->rx_bytes = service->rx_total;
+	sample->tx_bytes = service->tx_total;
+
+	service->next = (service->next + 1) % COUNTER_SAMPLES;
+	if (service->count < COUNTER_SAMPLES)
+		service->count++;
+
+	g_variant_unref(home);
+	g_variant_unref(roaming);
+}
+
+static void counter_method_call(GDBusConnection *connection,
+				const gchar *sender,
+				const gchar *object_path,
+				const gchar *interface_name,
+				const gchar *method_name,
+				GVariant *parameters,
+				GDBusMethodInvocation *invocation,
+				gpointer user_data)
+{
+	struct connman_manager *manager = user_data;
+
+	if (g_strcmp0(sender, manager->connman_owner) != 0) {
+		g_dbus_method_invocation_return_dbus_error(invocation,
+					CONNMAN_ERROR ".PermissionDenied",
+					"Permission denied");
+		return;
+	}
+
+	if (g_str_equal(method_name, "Usage") == TRUE)
+		counter_usage(manager, parameters);
+	else if (g_str_equal(method_name, "Release") == TRUE)
+		DBG("counter released");
+
+	g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+static const GDBusInterfaceVTable counter_vtable = {
+	counter_method_call,
+	NULL,
+	NULL,
+};
+
+static void counter_call_callback(GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	GVariant *reply;
+	GError *error = NULL;
+
+	reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object),
+						res, &error);
+	if (reply == NULL) {
+		DBG("%s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	g_variant_unref(reply);
+}
+
+static void counter_call(struct connman_manager *manager, const char *method,
+				GVariant *parameters)
+{
+	DBG("%s", method);
+
+	g_dbus_connection_call(manager->connection,
+				CONNMAN_DBUS_NAME,
+				CONNMAN_MANAGER_PATH,
+				CONNMAN_MANAGER_INTERFACE,
+				method,
+				parameters,
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				-1,
+				NULL,
+				counter_call_callback,
+				NULL);
+}
+
+static void register_counter(struct connman_manager *manager)
+{
+	counter_call(manager, "RegisterCounter",
+			g_variant_new("(ouu)", CONNMAN_COUNTER_PATH,
+					COUNTER_ACCURACY,
+					manager->counter_period));
+}
+
 static void connman_started(GDBusConnection *conn, const gchar *name,
 			const gchar *name_owner, void *user_data)
 {
@@ -139,6 +808,19 @@ static void connman_started(GDBusConnection *conn, const gchar *name,
 	DBG("connection %p manager %p", conn, manager);
 
 	manager->connman_running = TRUE;
+
+	g_free(manager->connman_owner);
+	manager->connman_owner = g_strdup(name_owner);
+
+	/*
+	 * A restarted ConnMan sends no signals for the state and services
+	 * it starts with. The first appearance is already being fetched.
+	 */
+	if (manager->pending == NULL)
+		get_properties(manager);
+
+	if (manager->counter_id != 0)
+		register_counter(manager);
 }
 
 static void connman_stopped(GDBusConnection *conn, const gchar *name,
@@ -150,16 +832,27 @@ static void connman_stopped(GDBusConnection *conn, const gchar *name,
 
 	manager->connman_running = FALSE;
 
-	update_property(manager, "State", "idle", manager->property_user_data);
+	g_free(manager->connman_owner);
+	manager->connman_owner = NULL;
+
+	g_hash_table_remove_all(manager->services);
+	g_free(manager->first_service);
+	manager->first_service = NULL;
+	update_default(manager);
+
+	/* A restarted ConnMan counts again from zero */
+	if (manager->counter_services != NULL)
+		g_hash_table_remove_all(manager->counter_services);
+
+	update_state(manager, "idle");
 }
 
 struct connman_manager *
-connman_manager_init(connman_property_changed_cb property_changed_cb,
+connman_manager_init(const struct connman_manager_callbacks *callbacks,
 			void *user_data)
 {
 	struct connman_manager *manager;
-	GDBusMessage *message;
-	int err = 0;
+	int err;
 
 	DBG("");
 
@@ -168,27 +861,15 @@ connman_manager_init(connman_property_changed_cb property_changed_cb,
 		return NULL;
 
 	manager->connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, NULL);
-	manager->property_changed_cb = property_changed_cb;
-	manager->property_user_data = user_data;
+	manager->callbacks = callbacks;
+	manager->user_data = user_data;
+	manager->services = g_hash_table_new_full(g_str_hash, g_str_equal,
+							g_free, service_free);
+	manager->default_strength = -1;
 
-	message = g_dbus_message_new_method_call(CONNMAN_DBUS_NAME,
-						CONNMAN_MANAGER_PATH,
-						CONNMAN_MANAGER_INTERFACE,
-						"GetProperties");
-	if (message == NULL) {
-		err = -ENOMEM;
+	err = get_properties(manager);
+	if (err < 0)
 		goto error;
-	}
-
-	manager->pending = g_cancellable_new();
-	g_dbus_connection_send_message_with_reply(manager->connection,
-						message,
-						G_DBUS_SEND_MESSAGE_FLAGS_NONE,
-						-1,
-						NULL,
-						manager->pending,
-						get_properties_callback,
-						manager);
 
 	manager->connman_watch = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
 						CONNMAN_DBUS_NAME,
@@ -219,17 +900,63 @@ connman_manager_init(connman_property_changed_cb property_changed_cb,
 		goto error;
 	}
 
-error:
-	if (message != NULL)
-		g_object_unref(message);
+	manager->services_changed_watch =
+		g_dbus_connection_signal_subscribe(manager->connection,
+						CONNMAN_DBUS_NAME,
+						CONNMAN_MANAGER_INTERFACE,
+						"ServicesChanged",
+						CONNMAN_MANAGER_PATH,
+						NULL,
+						G_DBUS_SIGNAL_FLAGS_NONE,
+						services_changed_signal_cb,
+						manager,
+						NULL);
 
-	if (err < 0) {
-		DBG("Cannot initialize manager");
-		connman_manager_cleanup(manager);
-		return NULL;
+	if (manager->services_changed_watch == 0) {
+		err = -EINVAL;
+		goto error;
+	}
+
+	manager->service_changed_watch =
+		g_dbus_connection_signal_subscribe(manager->connection,
+						CONNMAN_DBUS_NAME,
+						CONNMAN_SERVICE_INTERFACE,
+						"PropertyChanged",
+						NULL,
+						NULL,
+						G_DBUS_SIGNAL_FLAGS_NONE,
+						service_changed_signal_cb,
+						manager,
+						NULL);
+
+	if (manager->service_changed_watch == 0) {
+		err = -EINVAL;
+		goto error;
+	}
+
+	manager->prepare_for_sleep_watch =
+		g_dbus_connection_signal_subscribe(manager->connection,
+						LOGIND_DBUS_NAME,
+						LOGIND_MANAGER_INTERFACE,
+						"PrepareForSleep",
+						LOGIND_MANAGER_PATH,
+						NULL,
+						G_DBUS_SIGNAL_FLAGS_NONE,
+						prepare_for_sleep_signal_cb,
+						manager,
+						NULL);
+
+	if (manager->prepare_for_sleep_watch == 0) {
+		err = -EINVAL;
+		goto error;
 	}
 
 	return manager;
+
+error:
+	DBG("Cannot initialize manager");
+	connman_manager_cleanup(manager);
+	return NULL;
 }
 
 void connman_manager_cleanup(struct connman_manager *manager)
@@ -239,11 +966,35 @@ void connman_manager_cleanup(struct connman_manager *manager)
 
 	DBG("");
 
-	manager->property_changed_cb = NULL;
+	manager->callbacks = NULL;
+
+	connman_manager_disable_counter(manager);
+
 	manager->connman_running = FALSE;
 
-	if (manager->pending != NULL)
+	if (manager->pending != NULL) {
 		g_cancellable_cancel(manager->pending);
+		g_object_unref(manager->pending);
+		manager->pending = NULL;
+	}
+
+	if (manager->prepare_for_sleep_watch != 0) {
+		g_dbus_connection_signal_unsubscribe(manager->connection,
+					manager->prepare_for_sleep_watch);
+		manager->prepare_for_sleep_watch = 0;
+	}
+
+	if (manager->service_changed_watch != 0) {
+		g_dbus_connection_signal_unsubscribe(manager->connection,
+					manager->service_changed_watch);
+		manager->service_changed_watch = 0;
+	}
+
+	if (manager->services_changed_watch != 0) {
+		g_dbus_connection_signal_unsubscribe(manager->connection,
+					manager->services_changed_watch);
+		manager->services_changed_watch = 0;
+	}
 
 	if (manager->property_changed_watch != 0) {
 		g_dbus_connection_signal_unsubscribe(manager->connection,
@@ -258,8 +1009,155 @@ void connman_manager_cleanup(struct connman_manager *manager)
 
 	g_object_unref(manager->connection);
 
-	manager->property_user_data = NULL;
+	g_hash_table_destroy(manager->services);
+	g_free(manager->first_service);
+	g_free(manager->default_service);
+	g_free(manager->default_ipv4);
+	g_free(manager->default_ipv6);
+
+	if (manager->default_proxy != NULL)
+		g_variant_unref(manager->default_proxy);
+
+	g_free(manager->connman_owner);
+	manager->user_data = NULL;
 
 	g_free(manager);
 	manager = NULL;
 }
+
+int connman_manager_enable_counter(struct connman_manager *manager,
+					unsigned int period)
+{
+	GError *error = NULL;
+
+	if (manager == NULL || period == 0)
+		return -EINVAL;
+
+	DBG("period %u", period);
+
+	if (manager->counter_id != 0) {
+		if (manager->counter_period == period)
+			return 0;
+
+		connman_manager_disable_counter(manager);
+	}
+
+	manager->counter_info = g_dbus_node_info_new_for_xml(counter_xml,
+								&error);
+	if (manager->counter_info == NULL) {
+		DBG("%s", error->message);
+		g_error_free(error);
+		return -EINVAL;
+	}
+
+	manager->counter_id = g_dbus_connection_register_object(
+					manager->connection,
+					CONNMAN_COUNTER_PATH,
+					manager->counter_info->interfaces[0],
+					&counter_vtable,
+					manager, NULL, &error);
+	if (manager->counter_id == 0) {
+		DBG("%s", error->message);
+		g_error_free(error);
+		g_dbus_node_info_unref(manager->counter_info);
+		manager->counter_info = NULL;
+		return -EALREADY;
+	}
+
+	manager->counter_period = period;
+	manager->counter_services = g_hash_table_new_full(g_str_hash,
+							g_str_equal,
+							g_free, g_free);
+
+	if (manager->connman_running == TRUE)
+		register_counter(manager);
+
+	return 0;
+}
+
+void connman_manager_disable_counter(struct connman_manager *manager)
+{
+	if (manager == NULL || manager->counter_id == 0)
+		return;
+
+	DBG("");
+
+	if (manager->connman_running == TRUE)
+		counter_call(manager, "UnregisterCounter",
+				g_variant_new("(o)", CONNMAN_COUNTER_PATH));
+
+	g_dbus_connection_unregister_object(manager->connection,
+						manager->counter_id);
+	manager->counter_id = 0;
+	manager->counter_period = 0;
+
+	g_dbus_node_info_unref(manager->counter_info);
+	manager->counter_info = NULL;
+
+	g_hash_table_destroy(manager->counter_services);
+	manager->counter_services = NULL;
+}
+
+static void counter_service_rate(struct counter_service *service,
+				unsigned int period, gint64 now,
+				guint64 *rx_rate, guint64 *tx_rate)
+{
+	struct counter_sample *oldest, *newest;
+	gint64 end;
+
+	if (service->count < 2)
+		return;
+
+	oldest = &service->samples[(service->next + COUNTER_SAMPLES -
+					service->count) % COUNTER_SAMPLES];
+	newest = &service->samples[(service->next + COUNTER_SAMPLES - 1) %
+					COUNTER_SAMPLES];
+
+	/*
+	 * Nothing is reported while the service is quiet, so let the
+	 * rate decay instead of sticking to the last busy period.
+	 */
+	end = newest->time;
+	if (now - end > (gint64)period * 2 * G_USEC_PER_SEC)
+		end = now;
+
+	if (end <= oldest->time)
+		return;
+
+	*rx_rate += (newest->rx_bytes - oldest->rx_bytes) * G_USEC_PER_SEC /
+							(end - oldest->time);
+	*tx_rate += (newest->tx_bytes - oldest->tx_bytes) * G_USEC_PER_SEC /
+							(end - oldest->time);
+}
+
+int connman_manager_get_counter_rate(struct connman_manager *manager,
+					const char *service,
+					guint64 *rx_rate, guint64 *tx_rate)
+{
+	GHashTableIter iter;
+	gpointer value;
+	gint64 now;
+
+	if (manager == NULL || manager->counter_id == 0)
+		return -ENOENT;
+
+	*rx_rate = *tx_rate = 0;
+	now = g_get_monotonic_time();
+
+	if (service != NULL) {
+		value = g_hash_table_lookup(manager->counter_services, service);
+		if (value == NULL)
+			return -ENOENT;
+
+		counter_service_rate(value, manager->counter_period, now,
+					rx_rate, tx_rate);
+		return 0;
+	}
+
+	g_hash_table_iter_init(&iter, manager->counter_services);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE)
+		counter_service_rate(value, manager->counter_period, now,
+					rx_rate, tx_rate);
+
+	return 0;
+}
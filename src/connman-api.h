@@ -19,18 +19,41 @@
  *
  */
 
-typedef void (*connman_property_changed_cb)(const char *property,
-					void *value,
+/*
+ * Any callback may be NULL. The default service values describe the
+ * first connected service, all of them are NULL when there is none.
+ */
+struct connman_manager_callbacks {
+	void (*state_changed)(const char *state, void *user_data);
+	/* TRUE from suspend until the values have been fetched again */
+	void (*stale_changed)(gboolean stale, void *user_data);
+	/* -1 if the default service has no strength */
+	void (*strength_changed)(int strength, void *user_data);
+	/* Networks as address/netmask or address/prefix length */
+	void (*default_service_changed)(const char *path,
+					const char *ipv4_network,
+					const char *ipv6_network,
 					void *user_data);
+	/* The Proxy dictionary of the default service */
+	void (*proxy_changed)(GVariant *proxy, void *user_data);
+};
 
 struct connman_manager;
 
 struct connman_manager *
-connman_manager_init(connman_property_changed_cb property_changed_cb,
+connman_manager_init(const struct connman_manager_callbacks *callbacks,
 			void *user_data);
 
 void connman_manager_cleanup(struct connman_manager *manager);
 
+/* Rates are in bytes per second, a NULL service sums all services */
+int connman_manager_enable_counter(struct connman_manager *manager,
+					unsigned int period);
+void connman_manager_disable_counter(struct connman_manager *manager);
+int connman_manager_get_counter_rate(struct connman_manager *manager,
+					const char *service,
+					guint64 *rx_rate, guint64 *tx_rate);
+
 #define DBG(fmt, arg...) do {					       \
 	g_debug("%s:%s() " fmt "\n", __FILE__, __FUNCTION__ , ## arg); \
 } while (0)
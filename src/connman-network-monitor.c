@@ -27,14 +27,26 @@
 #include <gio/gio.h>
 
 #include "connman-api.h"
+#include "connman-vpn.h"
+#include "connman-probe.h"
+#include "connman-proxy.h"
 
 static int priority = 90;
 static guint network_changed_signal = 0;
+static guint default_service_changed_signal = 0;
 
 enum {
 	PROP_0,
 	PROP_NETWORK_AVAILABLE,
 	PROP_CONNECTIVITY,
+	PROP_COUNTER_PERIOD,
+	PROP_RX_RATE,
+	PROP_TX_RATE,
+	PROP_SIGNAL_STRENGTH,
+	PROP_LINK_QUALITY,
+	PROP_DEFAULT_SERVICE,
+	PROP_PROBE_TIMEOUT,
+	PROP_PROXY_RESOLVER,
 };
 
 enum connman_state {
@@ -45,11 +57,47 @@ enum connman_state {
 	STATE_FAILURE,
 };
 
+enum link_quality {
+	LINK_QUALITY_UNKNOWN = 0,
+	LINK_QUALITY_VERY_WEAK,
+	LINK_QUALITY_WEAK,
+	LINK_QUALITY_FAIR,
+	LINK_QUALITY_GOOD,
+};
+
+static const GEnumValue link_quality_values[] = {
+	{ LINK_QUALITY_UNKNOWN, "LINK_QUALITY_UNKNOWN", "unknown" },
+	{ LINK_QUALITY_VERY_WEAK, "LINK_QUALITY_VERY_WEAK", "very-weak" },
+	{ LINK_QUALITY_WEAK, "LINK_QUALITY_WEAK", "weak" },
+	{ LINK_QUALITY_FAIR, "LINK_QUALITY_FAIR", "fair" },
+	{ LINK_QUALITY_GOOD, "LINK_QUALITY_GOOD", "good" },
+	{ 0, NULL, NULL }
+};
+
+/* Registered with the module when it is loaded */
+static GType link_quality_type = G_TYPE_INVALID;
+
+/* Lowest strength of the weak, fair and good link qualities */
+static const int quality_limits[] = { 15, 35, 60 };
+
+/* How far the strength must leave a quality range before it changes */
+#define QUALITY_HYSTERESIS 5
+
 typedef struct _GNetworkMonitorConnmanPrivate GNetworkMonitorConnmanPrivate;
 struct _GNetworkMonitorConnmanPrivate
 {
 	enum connman_state state;
+	gboolean stale;
+	unsigned int counter_period;
+	int strength;
+	enum link_quality quality;
+	char *default_service;
+	gboolean default_changed;
 	struct connman_manager *manager;
+	struct connman_vpn *vpn;
+	unsigned int probe_timeout;
+	struct connman_probe *probe;
+	GProxyResolver *resolver;
 };
 
 typedef struct _GNetworkMonitorConnman GNetworkMonitorConnman;
@@ -113,6 +161,20 @@ static void network_monitor_finalize(GObject *object)
 
 	connman_manager_cleanup(monitor->priv->manager);
 	monitor->priv->manager = NULL;
+
+	connman_vpn_cleanup(monitor->priv->vpn);
+	monitor->priv->vpn = NULL;
+
+	connman_probe_cleanup(monitor->priv->probe);
+	monitor->priv->probe = NULL;
+
+	if (monitor->priv->resolver != NULL) {
+		g_object_unref(monitor->priv->resolver);
+		monitor->priv->resolver = NULL;
+	}
+
+	g_free(monitor->priv->default_service);
+	monitor->priv->default_service = NULL;
 	monitor->priv->state = STATE_UNKNOWN;
 
 	G_OBJECT_CLASS(g_network_monitor_connman_parent_class)->
@@ -137,9 +199,25 @@ static gboolean is_available(enum connman_state state)
 
 static gboolean get_state(GNetworkMonitorConnman *monitor)
 {
+	/* Nothing seen before suspend is trusted until the refresh ends */
+	if (monitor->priv->stale == TRUE)
+		return FALSE;
+
 	return is_available(monitor->priv->state);
 }
 
+static GNetworkConnectivity get_connectivity(GNetworkMonitorConnman *monitor)
+{
+	/* FIXME: Implement connectivity and captive portal checking. */
+	if (get_state(monitor) == FALSE)
+		return G_NETWORK_CONNECTIVITY_LOCAL;
+
+	if (monitor->priv->quality == LINK_QUALITY_VERY_WEAK)
+		return G_NETWORK_CONNECTIVITY_LIMITED;
+
+	return G_NETWORK_CONNECTIVITY_FULL;
+}
+
 static void get_property(GObject *object, guint prop_id,
 			GValue *value, GParamSpec *pspec)
 {
@@ -151,8 +229,75 @@ static void get_property(GObject *object, guint prop_id,
 		break;
 
 	case PROP_CONNECTIVITY:
-		/* FIXME: Implement connectivity and captive portal checking. */
-		g_value_set_enum(value, get_state(monitor) ? G_NETWORK_CONNECTIVITY_FULL : G_NETWORK_CONNECTIVITY_LOCAL);
+		g_value_set_enum(value, get_connectivity(monitor));
+		break;
+
+	case PROP_COUNTER_PERIOD:
+		g_value_set_uint(value, monitor->priv->counter_period);
+		break;
+
+	case PROP_RX_RATE:
+	case PROP_TX_RATE: {
+		guint64 rx_rate = 0, tx_rate = 0;
+
+		connman_manager_get_counter_rate(monitor->priv->manager, NULL,
+							&rx_rate, &tx_rate);
+		g_value_set_uint64(value, prop_id == PROP_RX_RATE ?
+							rx_rate : tx_rate);
+		break;
+	}
+
+	case PROP_SIGNAL_STRENGTH:
+		g_value_set_int(value, monitor->priv->strength);
+		break;
+
+	case PROP_LINK_QUALITY:
+		g_value_set_enum(value, monitor->priv->quality);
+		break;
+
+	case PROP_DEFAULT_SERVICE:
+		g_value_set_string(value, monitor->priv->default_service);
+		break;
+
+	case PROP_PROBE_TIMEOUT:
+		g_value_set_uint(value, monitor->priv->probe_timeout);
+		break;
+
+	case PROP_PROXY_RESOLVER:
+		g_value_set_object(value, monitor->priv->resolver);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+}
+
+static void set_counter_period(GNetworkMonitorConnman *monitor,
+					unsigned int period)
+{
+	DBG("period %u", period);
+
+	monitor->priv->counter_period = period;
+
+	if (period == 0)
+		connman_manager_disable_counter(monitor->priv->manager);
+	else
+		connman_manager_enable_counter(monitor->priv->manager, period);
+}
+
+static void set_property(GObject *object, guint prop_id,
+			const GValue *value, GParamSpec *pspec)
+{
+	GNetworkMonitorConnman *monitor = CONNMAN_NETWORK_MONITOR(object);
+
+	switch (prop_id) {
+	case PROP_COUNTER_PERIOD:
+		set_counter_period(monitor, g_value_get_uint(value));
+		break;
+
+	case PROP_PROBE_TIMEOUT:
+		monitor->priv->probe_timeout = g_value_get_uint(value);
 		break;
 
 	default:
@@ -170,6 +315,7 @@ g_network_monitor_connman_class_init(GNetworkMonitorConnmanClass *klass)
 	gobject_class->constructor = network_monitor_constructor;
 	gobject_class->finalize = network_monitor_finalize;
 	gobject_class->get_property = get_property;
+	gobject_class->set_property = set_property;
 
 	g_object_class_override_property(gobject_class,
 					PROP_NETWORK_AVAILABLE,
@@ -178,6 +324,80 @@ g_network_monitor_connman_class_init(GNetworkMonitorConnmanClass *klass)
 					PROP_CONNECTIVITY,
 					"connectivity");
 
+	/* Traffic statistics are only collected when a period is set */
+	g_object_class_install_property(gobject_class, PROP_COUNTER_PERIOD,
+		g_param_spec_uint("counter-period", "Counter period",
+				"Seconds between ConnMan traffic reports, "
+				"0 disables them",
+				0, G_MAXUINT, 0,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_RX_RATE,
+		g_param_spec_uint64("rx-rate", "Receive rate",
+				"Bytes received per second",
+				0, G_MAXUINT64, 0,
+				G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_TX_RATE,
+		g_param_spec_uint64("tx-rate", "Transmit rate",
+				"Bytes sent per second",
+				0, G_MAXUINT64, 0,
+				G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	/*
+	 * The strength follows every change but is never notified,
+	 * listeners are only woken when the link quality changes.
+	 */
+	g_object_class_install_property(gobject_class, PROP_SIGNAL_STRENGTH,
+		g_param_spec_int("signal-strength", "Signal strength",
+				"Strength of the default service, "
+				"-1 if not known",
+				-1, 100, -1,
+				G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_LINK_QUALITY,
+		g_param_spec_enum("link-quality", "Link quality",
+				"Quality of the default service link",
+				link_quality_type, LINK_QUALITY_UNKNOWN,
+				G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_DEFAULT_SERVICE,
+		g_param_spec_string("default-service", "Default service",
+				"Object path of the connected ConnMan "
+				"service that carries the default route",
+				NULL,
+				G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	/*
+	 * can_reach() only connects to the host when a timeout is set,
+	 * can_reach_async() does so without blocking the main loop.
+	 */
+	g_object_class_install_property(gobject_class, PROP_PROBE_TIMEOUT,
+		g_param_spec_uint("probe-timeout", "Probe timeout",
+				"Milliseconds a reachability probe may take, "
+				"0 disables probing",
+				0, G_MAXUINT, 0,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	/*
+	 * Follows the Proxy settings of the default service. Applications
+	 * use it with g_socket_client_set_proxy_resolver(), it is not
+	 * installed as the default resolver of the process.
+	 */
+	g_object_class_install_property(gobject_class, PROP_PROXY_RESOLVER,
+		g_param_spec_object("proxy-resolver", "Proxy resolver",
+				"Proxy resolver using the ConnMan settings",
+				G_TYPE_PROXY_RESOLVER,
+				G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	/*
+	 * Emitted when the default service or its addresses change,
+	 * also when the network stays available the whole time.
+	 */
+	default_service_changed_signal =
+		g_signal_new("default-service-changed",
+				G_TYPE_FROM_CLASS(klass),
+				G_SIGNAL_RUN_LAST,
+				0, NULL, NULL,
+				g_cclosure_marshal_VOID__STRING,
+				G_TYPE_NONE, 1, G_TYPE_STRING);
+
 	g_type_class_add_private(gobject_class,
 				sizeof(GNetworkMonitorConnmanPrivate));
 }
@@ -201,8 +421,122 @@ static enum connman_state string2state(const char *state)
 	return STATE_UNKNOWN;
 }
 
-static void property_changed(const char *property, void *value,
-							void *user_data)
+static enum link_quality strength2quality(int strength,
+					enum link_quality current)
+{
+	enum link_quality quality = LINK_QUALITY_VERY_WEAK;
+	int low, high;
+	unsigned int i;
+
+	if (strength < 0)
+		return LINK_QUALITY_UNKNOWN;
+
+	for (i = 0; i < G_N_ELEMENTS(quality_limits); i++) {
+		if (strength >= quality_limits[i])
+			quality = LINK_QUALITY_WEAK + i;
+	}
+
+	if (current == LINK_QUALITY_UNKNOWN || quality == current)
+		return quality;
+
+	low = current == LINK_QUALITY_VERY_WEAK ? 0 :
+				quality_limits[current - LINK_QUALITY_WEAK];
+	high = current == LINK_QUALITY_GOOD ? 101 :
+				quality_limits[current - LINK_QUALITY_VERY_WEAK];
+
+	if (strength >= low - QUALITY_HYSTERESIS &&
+			strength < high + QUALITY_HYSTERESIS)
+		return current;
+
+	return quality;
+}
+
+static void set_strength(GNetworkMonitorConnman *monitor, int strength)
+{
+	GNetworkConnectivity connectivity;
+	enum link_quality quality;
+
+	monitor->priv->strength = strength;
+
+	quality = strength2quality(strength, monitor->priv->quality);
+	if (quality == monitor->priv->quality)
+		return;
+
+	DBG("strength %d quality %d", strength, quality);
+
+	connectivity = get_connectivity(monitor);
+	monitor->priv->quality = quality;
+
+	if (monitor->priv->stale == TRUE)
+		return;
+
+	g_object_notify(G_OBJECT(monitor), "link-quality");
+
+	if (get_connectivity(monitor) != connectivity)
+		g_object_notify(G_OBJECT(monitor), "connectivity");
+}
+
+static void set_default_service(GNetworkMonitorConnman *monitor,
+					const char *service)
+{
+	DBG("service %s", service);
+
+	g_free(monitor->priv->default_service);
+	monitor->priv->default_service = g_strdup(service);
+
+	connman_probe_flush(monitor->priv->probe);
+
+	if (monitor->priv->stale == TRUE) {
+		monitor->priv->default_changed = TRUE;
+		return;
+	}
+
+	g_object_notify(G_OBJECT(monitor), "default-service");
+	g_signal_emit(monitor, default_service_changed_signal, 0, service);
+}
+
+static void set_stale(GNetworkMonitorConnman *monitor, gboolean stale)
+{
+	DBG("stale %d", stale);
+
+	if (monitor->priv->stale == stale)
+		return;
+
+	monitor->priv->stale = stale;
+	connman_probe_flush(monitor->priv->probe);
+
+	/*
+	 * The network is reported unavailable until the refresh ends,
+	 * tell it now so the property and the signal agree meanwhile.
+	 */
+	if (stale == TRUE) {
+		if (is_available(monitor->priv->state) == TRUE) {
+			g_signal_emit(monitor, network_changed_signal, 0,
+								FALSE);
+			g_object_notify(G_OBJECT(monitor), "connectivity");
+		}
+		return;
+	}
+
+	/*
+	 * Connections made before suspend are most likely dead, so
+	 * always tell once that the network has changed, whatever
+	 * the refreshed state is.
+	 */
+	g_signal_emit(monitor, network_changed_signal, 0, get_state(monitor));
+
+	g_object_notify(G_OBJECT(monitor), "link-quality");
+	g_object_notify(G_OBJECT(monitor), "connectivity");
+
+	if (monitor->priv->default_changed == TRUE) {
+		monitor->priv->default_changed = FALSE;
+		g_object_notify(G_OBJECT(monitor), "default-service");
+		g_signal_emit(monitor, default_service_changed_signal, 0,
+					monitor->priv->default_service);
+	}
+}
+
+static void state_changed(const char *state, void *user_data)
 {
 	GNetworkMonitorConnman *monitor = user_data;
 	enum connman_state old_state, new_state;
@@ -212,20 +546,78 @@ static void property_changed(const char *property, void *value,
 		return;
 	}
 
-	old_state = new_state = monitor->priv->state;
+	DBG("state \"%s\"", state);
 
-	if (g_strcmp0(property, "State") == 0) {
-		new_state = string2state(value);
-		DBG("property %s value \"%s\"", property, (char *)value);
-	}
+	old_state = monitor->priv->state;
+	new_state = string2state(state);
+
+	monitor->priv->state = new_state;
+
+	if (new_state != old_state)
+		connman_probe_flush(monitor->priv->probe);
+
+	/* Changes are reported in one go when the state is refreshed */
+	if (monitor->priv->stale == TRUE)
+		return;
 
 	if (is_available(new_state) != is_available(old_state)) {
-		monitor->priv->state = new_state;
 		g_signal_emit(monitor, network_changed_signal, 0,
 							get_state(monitor));
+		g_object_notify(G_OBJECT(monitor), "connectivity");
 	}
 }
 
+static void stale_changed(gboolean stale, void *user_data)
+{
+	set_stale(user_data, stale);
+}
+
+static void strength_changed(int strength, void *user_data)
+{
+	set_strength(user_data, strength);
+}
+
+static void default_service_changed(const char *path,
+					const char *ipv4_network,
+					const char *ipv6_network,
+					void *user_data)
+{
+	GNetworkMonitorConnman *monitor = user_data;
+
+	connman_vpn_set_local_networks(monitor->priv->vpn, ipv4_network,
+							ipv6_network);
+	set_default_service(monitor, path);
+}
+
+static void proxy_changed(GVariant *proxy, void *user_data)
+{
+	GNetworkMonitorConnman *monitor = user_data;
+
+	connman_proxy_resolver_update(monitor->priv->resolver, proxy);
+}
+
+static const struct connman_manager_callbacks manager_callbacks = {
+	.state_changed = state_changed,
+	.stale_changed = stale_changed,
+	.strength_changed = strength_changed,
+	.default_service_changed = default_service_changed,
+	.proxy_changed = proxy_changed,
+};
+
+static void vpn_changed(void *user_data)
+{
+	GNetworkMonitorConnman *monitor = user_data;
+
+	DBG("");
+
+	connman_probe_flush(monitor->priv->probe);
+
+	/* Hosts behind a split tunnel came or went */
+	if (monitor->priv->stale == FALSE)
+		g_signal_emit(monitor, network_changed_signal, 0,
+							get_state(monitor));
+}
+
 static void g_network_monitor_connman_init(GNetworkMonitorConnman *self)
 {
 	/* Leak the module to keep it from being unloaded. */
@@ -234,6 +626,7 @@ static void g_network_monitor_connman_init(GNetworkMonitorConnman *self)
 	self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
 						CONNMAN_TYPE_NETWORK_MONITOR,
 						GNetworkMonitorConnmanPrivate);
+	self->priv->strength = -1;
 }
 
 static gboolean network_monitor_initable_init(GInitable *initable,
@@ -242,7 +635,14 @@ static gboolean network_monitor_initable_init(GInitable *initable,
 {
 	GNetworkMonitorConnman *cm = CONNMAN_NETWORK_MONITOR(initable);
 
-	cm->priv->manager = connman_manager_init(property_changed, cm);
+	cm->priv->resolver = connman_proxy_resolver_new();
+	cm->priv->manager = connman_manager_init(&manager_callbacks, cm);
+	cm->priv->vpn = connman_vpn_init(vpn_changed, cm);
+	cm->priv->probe = connman_probe_init();
+
+	if (cm->priv->counter_period > 0)
+		connman_manager_enable_counter(cm->priv->manager,
+						cm->priv->counter_period);
 
 	DBG("cm %p manager %p", cm, cm->priv->manager);
 
@@ -254,42 +654,59 @@ static void network_monitor_initable_iface_init(GInitableIface *iface)
 	iface->init = network_monitor_initable_init;
 }
 
-static gboolean is_local(GSocketConnectable *connectable,
-			GCancellable *cancellable)
+/*
+ * Only loopback addresses and localhost count, nothing is resolved
+ * and no proxy resolver is asked.
+ */
+static gboolean is_local(GSocketConnectable *connectable)
 {
-	GSocketAddressEnumerator *enumerator;
-	GSocketAddress *addr;
-	GError *error = NULL;
+	GInetAddress *addr;
+	const char *host;
+	gboolean local;
+
+	if (G_IS_INET_SOCKET_ADDRESS(connectable)) {
+		addr = g_inet_socket_address_get_address(
+					G_INET_SOCKET_ADDRESS(connectable));
+		return g_inet_address_get_is_loopback(addr);
+	}
 
-	enumerator = g_socket_connectable_proxy_enumerate(connectable);
-	addr = g_socket_address_enumerator_next(enumerator, cancellable,
-						&error);
-	if (addr == NULL) {
-		g_object_unref(enumerator);
+	if (G_IS_NETWORK_ADDRESS(connectable))
+		host = g_network_address_get_hostname(
+					G_NETWORK_ADDRESS(connectable));
+	else if (G_IS_NETWORK_SERVICE(connectable))
+		host = g_network_service_get_domain(
+					G_NETWORK_SERVICE(connectable));
+	else
 		return FALSE;
-	}
 
-	while (addr != NULL) {
-		if (G_IS_INET_SOCKET_ADDRESS(addr)) {
-			GInetAddress *iaddr;
-
-			iaddr = g_inet_socket_address_get_address(
-						G_INET_SOCKET_ADDRESS(addr));
-			if (g_inet_address_get_is_loopback(iaddr) == TRUE) {
-				g_object_unref(addr);
-				g_object_unref(enumerator);
-				return TRUE;
-			}
-		}
+	if (g_ascii_strcasecmp(host, "localhost") == 0)
+		return TRUE;
 
-		g_object_unref(addr);
-		addr = g_socket_address_enumerator_next(enumerator,
-							cancellable,
-							&error);
-	}
+	addr = g_inet_address_new_from_string(host);
+	if (addr == NULL)
+		return FALSE;
 
-	g_object_unref(enumerator);
-	return FALSE;
+	local = g_inet_address_get_is_loopback(addr);
+	g_object_unref(addr);
+
+	return local;
+}
+
+static void set_network_unreachable(GError **error)
+{
+	if (error && *error == NULL)
+		g_set_error_literal(error, G_IO_ERROR,
+				G_IO_ERROR_NETWORK_UNREACHABLE,
+				"No network connections available");
+}
+
+static void set_vpn_unreachable(GError **error)
+{
+	if (error && *error == NULL)
+		g_set_error_literal(error, G_IO_ERROR,
+				G_IO_ERROR_HOST_UNREACHABLE,
+				"Host is only routed through a "
+				"disconnected VPN");
 }
 
 static gboolean can_reach(GNetworkMonitor *monitor,
@@ -302,29 +719,134 @@ static gboolean can_reach(GNetworkMonitor *monitor,
 	DBG("");
 
 	if (get_state(cm) == FALSE) {
-		if (is_local(connectable, cancellable) == TRUE)
-			return TRUE;
-
-		if (error && *error == NULL)
-			g_set_error_literal(error, G_IO_ERROR,
-					G_IO_ERROR_NETWORK_UNREACHABLE,
-					"No network connections available");
+		if (is_local(connectable) == FALSE) {
+			set_network_unreachable(error);
+			return FALSE;
+		}
+	} else if (connman_vpn_can_reach(cm->priv->vpn, connectable,
+						cancellable) == FALSE) {
+		set_vpn_unreachable(error);
 		return FALSE;
 	}
 
+	/* Local targets are probed too, the service may not be running */
+	if (cm->priv->probe_timeout > 0)
+		return connman_probe_can_reach(cm->priv->probe, connectable,
+						cm->priv->probe_timeout,
+						cancellable, error);
+
 	return TRUE;
 }
 
+static void can_reach_probe_callback(GObject *source_object,
+					GAsyncResult *res,
+					gpointer user_data)
+{
+	GTask *task = user_data;
+	GNetworkMonitorConnman *cm = g_task_get_source_object(task);
+	GError *error = NULL;
+
+	if (connman_probe_can_reach_finish(cm->priv->probe, res,
+							&error) == TRUE)
+		g_task_return_boolean(task, TRUE);
+	else
+		g_task_return_error(task, error);
+
+	g_object_unref(task);
+}
+
+static void can_reach_probe(GTask *task)
+{
+	GNetworkMonitorConnman *cm = g_task_get_source_object(task);
+
+	if (cm->priv->probe_timeout == 0) {
+		g_task_return_boolean(task, TRUE);
+		g_object_unref(task);
+		return;
+	}
+
+	connman_probe_can_reach_async(cm->priv->probe,
+					g_task_get_task_data(task),
+					cm->priv->probe_timeout,
+					g_task_get_cancellable(task),
+					can_reach_probe_callback, task);
+}
+
+static void can_reach_vpn_callback(GObject *source_object,
+					GAsyncResult *res,
+					gpointer user_data)
+{
+	GTask *task = user_data;
+	GNetworkMonitorConnman *cm = g_task_get_source_object(task);
+	GError *error = NULL;
+
+	if (connman_vpn_can_reach_finish(cm->priv->vpn, res,
+							&error) == FALSE) {
+		set_vpn_unreachable(&error);
+		g_task_return_error(task, error);
+		g_object_unref(task);
+		return;
+	}
+
+	can_reach_probe(task);
+}
+
+/* Names are resolved asynchronously, nothing here blocks the caller */
+static void can_reach_async(GNetworkMonitor *monitor,
+				GSocketConnectable *connectable,
+				GCancellable *cancellable,
+				GAsyncReadyCallback callback,
+				gpointer user_data)
+{
+	GNetworkMonitorConnman *cm = CONNMAN_NETWORK_MONITOR(monitor);
+	GError *error = NULL;
+	GTask *task;
+
+	DBG("");
+
+	task = g_task_new(monitor, cancellable, callback, user_data);
+	g_task_set_task_data(task, g_object_ref(connectable),
+						g_object_unref);
+
+	if (get_state(cm) == FALSE) {
+		if (is_local(connectable) == FALSE) {
+			set_network_unreachable(&error);
+			g_task_return_error(task, error);
+			g_object_unref(task);
+			return;
+		}
+
+		can_reach_probe(task);
+		return;
+	}
+
+	connman_vpn_can_reach_async(cm->priv->vpn, connectable, cancellable,
+					can_reach_vpn_callback, task);
+}
+
+static gboolean can_reach_finish(GNetworkMonitor *monitor,
+					GAsyncResult *result,
+					GError **error)
+{
+	return g_task_propagate_boolean(G_TASK(result), error);
+}
+
 static void network_monitor_iface_init(GNetworkMonitorInterface *iface)
 {
 	network_changed_signal = g_signal_lookup("network-changed",
 						G_TYPE_NETWORK_MONITOR);
 
 	iface->can_reach = can_reach;
+	iface->can_reach_async = can_reach_async;
+	iface->can_reach_finish = can_reach_finish;
 }
 
 void g_io_module_load(GIOModule *module)
 {
+	link_quality_type = g_type_module_register_enum (G_TYPE_MODULE (module),
+					"GNetworkMonitorConnmanLinkQuality",
+					link_quality_values);
+	connman_proxy_register_type (G_TYPE_MODULE (module));
 	g_network_monitor_connman_register_type (G_TYPE_MODULE (module));
 	g_io_extension_point_implement (G_NETWORK_MONITOR_EXTENSION_POINT_NAME,
 	                                CONNMAN_TYPE_NETWORK_MONITOR,
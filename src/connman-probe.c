@@ -0,0 +1,946 @@
+/*
+ *
+ *  Network Monitor for Connection Manager
+ *
+ *  Copyright (C) 2012  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License version 2.1,
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <gio/gio.h>
+
+#include "connman-api.h"
+#include "connman-probe.h"
+
+/* Probes running at the same time, in total and towards one host */
+#define PROBE_MAX 8
+#define PROBE_MAX_PER_HOST 2
+
+struct connman_probe {
+	gint refcount;
+	GMutex lock;
+	GCond cond;
+	unsigned int running;
+	GList *started;
+	GHashTable *hosts;
+	GHashTable *entries;
+	GQueue queue;
+};
+
+/*
+ * One connection attempt to a host and port. Blocking callers run it in
+ * a main context of their own and wait on the condition, asynchronous
+ * callers run it in their thread default context and wait as tasks.
+ */
+struct probe_entry {
+	gint refcount;
+	struct connman_probe *probe;
+	char *key;
+	char *host;
+	GSocketConnectable *connectable;
+	GMainContext *context;
+	GCancellable *cancellable;
+	gboolean sync;
+	gboolean started;
+	gboolean timed_out;
+	gboolean done;
+	gboolean reachable;
+	GError *error;
+	GList *waiters;
+};
+
+struct probe_waiter {
+	gint refcount;
+	struct probe_entry *entry;
+	GTask *task;
+	GSource *timeout;
+	GSource *cancelled;
+	gboolean finished;
+	gboolean reachable;
+	GError *error;
+};
+
+/* Work collected under the lock and done once it is released */
+struct probe_batch {
+	GList *waiters;
+	GList *starts;
+	GList *unrefs;
+};
+
+static void probe_unref(struct connman_probe *probe)
+{
+	if (g_atomic_int_dec_and_test(&probe->refcount) == FALSE)
+		return;
+
+	g_hash_table_destroy(probe->entries);
+	g_hash_table_destroy(probe->hosts);
+
+	g_cond_clear(&probe->cond);
+	g_mutex_clear(&probe->lock);
+
+	g_free(probe);
+}
+
+static struct probe_entry *entry_new(struct connman_probe *probe,
+					const char *key, const char *host,
+					GSocketConnectable *connectable,
+					gboolean sync)
+{
+	struct probe_entry *entry;
+
+	entry = g_new0(struct probe_entry, 1);
+	entry->refcount = 1;
+	entry->probe = probe;
+	entry->key = g_strdup(key);
+	entry->host = g_strdup(host);
+	entry->connectable = g_object_ref(connectable);
+	entry->cancellable = g_cancellable_new();
+	entry->sync = sync;
+
+	g_atomic_int_inc(&probe->refcount);
+
+	return entry;
+}
+
+static struct probe_entry *entry_ref(struct probe_entry *entry)
+{
+	g_atomic_int_inc(&entry->refcount);
+
+	return entry;
+}
+
+/* Not to be called with the lock held, the last entry frees the probe */
+static void entry_unref(gpointer data)
+{
+	struct probe_entry *entry = data;
+
+	if (g_atomic_int_dec_and_test(&entry->refcount) == FALSE)
+		return;
+
+	if (entry->error != NULL)
+		g_error_free(entry->error);
+
+	if (entry->context != NULL)
+		g_main_context_unref(entry->context);
+
+	g_object_unref(entry->cancellable);
+	g_object_unref(entry->connectable);
+	g_free(entry->host);
+	g_free(entry->key);
+
+	probe_unref(entry->probe);
+
+	g_free(entry);
+}
+
+static struct probe_waiter *waiter_ref(struct probe_waiter *waiter)
+{
+	g_atomic_int_inc(&waiter->refcount);
+
+	return waiter;
+}
+
+static void waiter_unref(gpointer data)
+{
+	struct probe_waiter *waiter = data;
+
+	if (g_atomic_int_dec_and_test(&waiter->refcount) == FALSE)
+		return;
+
+	if (waiter->error != NULL)
+		g_error_free(waiter->error);
+
+	g_object_unref(waiter->task);
+	entry_unref(waiter->entry);
+
+	g_free(waiter);
+}
+
+static char *connectable_host(GSocketConnectable *connectable,
+				guint16 *port)
+{
+	if (G_IS_NETWORK_ADDRESS(connectable)) {
+		GNetworkAddress *addr = G_NETWORK_ADDRESS(connectable);
+
+		*port = g_network_address_get_port(addr);
+		return g_strdup(g_network_address_get_hostname(addr));
+	}
+
+	if (G_IS_INET_SOCKET_ADDRESS(connectable)) {
+		GInetSocketAddress *addr = G_INET_SOCKET_ADDRESS(connectable);
+
+		*port = g_inet_socket_address_get_port(addr);
+		return g_inet_address_to_string(
+				g_inet_socket_address_get_address(addr));
+	}
+
+	return NULL;
+}
+
+static gboolean entry_result(struct probe_entry *entry, GError **error)
+{
+	if (entry->reachable == FALSE && error != NULL && *error == NULL)
+		*error = g_error_copy(entry->error);
+
+	return entry->reachable;
+}
+
+static unsigned int host_running(struct connman_probe *probe,
+				const char *host)
+{
+	return GPOINTER_TO_UINT(g_hash_table_lookup(probe->hosts, host));
+}
+
+static void set_host_running(struct connman_probe *probe, const char *host,
+				unsigned int running)
+{
+	if (running == 0)
+		g_hash_table_remove(probe->hosts, host);
+	else
+		g_hash_table_replace(probe->hosts, g_strdup(host),
+						GUINT_TO_POINTER(running));
+}
+
+static gboolean slot_free(struct connman_probe *probe, const char *host)
+{
+	return probe->running < PROBE_MAX &&
+			host_running(probe, host) < PROBE_MAX_PER_HOST;
+}
+
+/*
+ * Probes run by a main loop of the calling thread cannot make progress
+ * while it blocks, so a blocking caller does not wait for their slots.
+ */
+static gboolean slot_free_blocking(struct connman_probe *probe,
+					const char *host)
+{
+	unsigned int running = probe->running;
+	unsigned int per_host = host_running(probe, host);
+	GList *list;
+
+	for (list = probe->started; list != NULL; list = list->next) {
+		struct probe_entry *entry = list->data;
+
+		if (entry->sync == TRUE ||
+			g_main_context_is_owner(entry->context) == FALSE)
+			continue;
+
+		running--;
+		if (g_str_equal(entry->host, host) == TRUE)
+			per_host--;
+	}
+
+	return running < PROBE_MAX && per_host < PROBE_MAX_PER_HOST;
+}
+
+static void slot_take(struct connman_probe *probe, struct probe_entry *entry)
+{
+	entry->started = TRUE;
+	probe->started = g_list_prepend(probe->started, entry);
+
+	probe->running++;
+	set_host_running(probe, entry->host,
+				host_running(probe, entry->host) + 1);
+
+	DBG("probing %s running %u", entry->key, probe->running);
+}
+
+static void waiter_finish_locked(struct probe_waiter *waiter,
+					gboolean reachable, GError *error,
+					struct probe_batch *batch)
+{
+	struct probe_entry *entry = waiter->entry;
+
+	waiter->finished = TRUE;
+	waiter->reachable = reachable;
+	waiter->error = error;
+
+	entry->waiters = g_list_remove(entry->waiters, waiter);
+
+	if (waiter->timeout != NULL) {
+		g_source_destroy(waiter->timeout);
+		g_source_unref(waiter->timeout);
+		waiter->timeout = NULL;
+	}
+
+	if (waiter->cancelled != NULL) {
+		g_source_destroy(waiter->cancelled);
+		g_source_unref(waiter->cancelled);
+		waiter->cancelled = NULL;
+	}
+
+	/* The reference of the waiter list moves to the batch */
+	batch->waiters = g_list_prepend(batch->waiters, waiter);
+}
+
+static void start_queued_locked(struct connman_probe *probe,
+					struct probe_batch *batch)
+{
+	GList *list, *next;
+
+	for (list = probe->queue.head; list != NULL; list = next) {
+		struct probe_entry *entry = list->data;
+
+		next = list->next;
+
+		if (slot_free(probe, entry->host) == FALSE)
+			continue;
+
+		g_queue_delete_link(&probe->queue, list);
+		slot_take(probe, entry);
+
+		/* The reference of the queue moves to the batch */
+		batch->starts = g_list_append(batch->starts, entry);
+	}
+}
+
+static void entry_complete_locked(struct probe_entry *entry,
+					gboolean reachable, GError *error,
+					gboolean cache,
+					struct probe_batch *batch)
+{
+	struct connman_probe *probe = entry->probe;
+
+	if (entry->done == TRUE) {
+		if (error != NULL)
+			g_error_free(error);
+		return;
+	}
+
+	DBG("%s is %sreachable", entry->key, reachable ? "" : "not ");
+
+	entry->done = TRUE;
+	entry->reachable = reachable;
+	entry->error = error;
+
+	if (entry->started == TRUE) {
+		probe->started = g_list_remove(probe->started, entry);
+		probe->running--;
+		set_host_running(probe, entry->host,
+					host_running(probe, entry->host) - 1);
+	} else if (g_queue_remove(&probe->queue, entry) == TRUE)
+		batch->unrefs = g_list_prepend(batch->unrefs, entry);
+
+	if (cache == FALSE &&
+			g_hash_table_lookup(probe->entries, entry->key) == entry) {
+		g_hash_table_remove(probe->entries, entry->key);
+		batch->unrefs = g_list_prepend(batch->unrefs, entry);
+	}
+
+	while (entry->waiters != NULL)
+		waiter_finish_locked(entry->waiters->data, reachable,
+				error != NULL ? g_error_copy(error) : NULL,
+				batch);
+
+	start_queued_locked(probe, batch);
+
+	g_cond_broadcast(&probe->cond);
+}
+
+static void probe_start(struct probe_entry *entry);
+
+static gboolean entry_start(gpointer user_data)
+{
+	struct probe_entry *entry = user_data;
+
+	probe_start(entry);
+	entry_unref(entry);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void batch_run(struct probe_batch *batch)
+{
+	GList *list;
+
+	/* Queued probes start in the context of their callers */
+	for (list = batch->starts; list != NULL; list = list->next) {
+		struct probe_entry *entry = list->data;
+
+		g_main_context_invoke(entry->context, entry_start, entry);
+	}
+
+	for (list = batch->waiters; list != NULL; list = list->next) {
+		struct probe_waiter *waiter = list->data;
+
+		if (waiter->reachable == TRUE)
+			g_task_return_boolean(waiter->task, TRUE);
+		else {
+			g_task_return_error(waiter->task, waiter->error);
+			waiter->error = NULL;
+		}
+
+		waiter_unref(waiter);
+	}
+
+	g_list_free_full(batch->unrefs, entry_unref);
+
+	g_list_free(batch->starts);
+	g_list_free(batch->waiters);
+}
+
+static void entry_finish(struct probe_entry *entry, gboolean reachable,
+				GError *error, gboolean cache)
+{
+	struct probe_batch batch = { NULL, NULL, NULL };
+
+	g_mutex_lock(&entry->probe->lock);
+	entry_complete_locked(entry, reachable, error, cache, &batch);
+	g_mutex_unlock(&entry->probe->lock);
+
+	batch_run(&batch);
+}
+
+static void probe_connected(GObject *source_object, GAsyncResult *res,
+				gpointer user_data)
+{
+	struct probe_entry *entry = user_data;
+	GSocketConnection *connection;
+	GError *error = NULL;
+	gboolean reachable = FALSE, cache = FALSE;
+
+	connection = g_socket_client_connect_finish(
+					G_SOCKET_CLIENT(source_object),
+					res, &error);
+	/*
+	 * A probe that timed out or was cancelled says nothing about the
+	 * host, a caller with more time may still reach it. Neither is
+	 * cached, the same as when asynchronous waiters time out.
+	 */
+	if (connection != NULL) {
+		reachable = TRUE;
+		cache = TRUE;
+		g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+		g_object_unref(connection);
+	} else if (entry->timed_out == TRUE) {
+		g_clear_error(&error);
+		g_set_error_literal(&error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+					"Probe timed out");
+	} else if (g_error_matches(error, G_IO_ERROR,
+					G_IO_ERROR_CANCELLED) == FALSE)
+		cache = TRUE;
+
+	entry_finish(entry, reachable, error, cache);
+	entry_unref(entry);
+}
+
+/* Resolves and connects in the thread default context */
+static void probe_start(struct probe_entry *entry)
+{
+	GSocketClient *client;
+
+	client = g_socket_client_new();
+
+	/* A proxy would answer for hosts that cannot be reached */
+	g_socket_client_set_enable_proxy(client, FALSE);
+
+	g_socket_client_connect_async(client, entry->connectable,
+					entry->cancellable, probe_connected,
+					entry_ref(entry));
+
+	g_object_unref(client);
+}
+
+static gboolean entry_is_done(struct probe_entry *entry)
+{
+	gboolean done;
+
+	g_mutex_lock(&entry->probe->lock);
+	done = entry->done;
+	g_mutex_unlock(&entry->probe->lock);
+
+	return done;
+}
+
+static gboolean entry_timeout(gpointer user_data)
+{
+	struct probe_entry *entry = user_data;
+
+	entry->timed_out = TRUE;
+	g_cancellable_cancel(entry->cancellable);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean entry_cancelled(GCancellable *cancellable, gpointer user_data)
+{
+	struct probe_entry *entry = user_data;
+
+	g_cancellable_cancel(entry->cancellable);
+
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Runs the probe of a blocking caller in a private main context, so the
+ * name lookup is bounded by the deadline as well as the connect.
+ */
+static void probe_run(struct probe_entry *entry, gint64 deadline,
+				GCancellable *cancellable)
+{
+	GMainContext *context;
+	GSource *timeout, *cancelled = NULL;
+	gint64 remaining;
+
+	context = g_main_context_new();
+	g_main_context_push_thread_default(context);
+
+	remaining = deadline - g_get_monotonic_time();
+
+	timeout = g_timeout_source_new(remaining > 0 ? remaining / 1000 : 0);
+	g_source_set_callback(timeout, entry_timeout, entry, NULL);
+	g_source_attach(timeout, context);
+
+	if (cancellable != NULL) {
+		cancelled = g_cancellable_source_new(cancellable);
+		g_source_set_callback(cancelled, (GSourceFunc)entry_cancelled,
+								entry, NULL);
+		g_source_attach(cancelled, context);
+	}
+
+	probe_start(entry);
+
+	while (entry_is_done(entry) == FALSE)
+		g_main_context_iteration(context, TRUE);
+
+	g_source_destroy(timeout);
+	g_source_unref(timeout);
+
+	if (cancelled != NULL) {
+		g_source_destroy(cancelled);
+		g_source_unref(cancelled);
+	}
+
+	/* Let the socket client drop what it still has queued here */
+	while (g_main_context_pending(context) == TRUE)
+		g_main_context_iteration(context, FALSE);
+
+	g_main_context_pop_thread_default(context);
+	g_main_context_unref(context);
+}
+
+static void wake_up(GCancellable *cancellable, gpointer user_data)
+{
+	struct connman_probe *probe = user_data;
+
+	g_mutex_lock(&probe->lock);
+	g_cond_broadcast(&probe->cond);
+	g_mutex_unlock(&probe->lock);
+}
+
+/*
+ * Waits with the lock held until the entry is done, or a slot the
+ * blocking caller can use is free when there is no entry. FALSE if the
+ * caller ran out of time or was cancelled first.
+ */
+static gboolean wait_locked(struct connman_probe *probe,
+				struct probe_entry *entry, const char *host,
+				gint64 deadline, GCancellable *cancellable,
+				GError **error)
+{
+	while (1) {
+		if (entry != NULL ? entry->done :
+				slot_free_blocking(probe, host))
+			return TRUE;
+
+		if (g_cancellable_set_error_if_cancelled(cancellable,
+							error) == TRUE)
+			return FALSE;
+
+		if (g_cond_wait_until(&probe->cond, &probe->lock,
+							deadline) == FALSE)
+			break;
+	}
+
+	if (entry != NULL ? entry->done : slot_free_blocking(probe, host))
+		return TRUE;
+
+	g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+						"Probe timed out");
+
+	return FALSE;
+}
+
+gboolean connman_probe_can_reach(struct connman_probe *probe,
+				GSocketConnectable *connectable,
+				unsigned int timeout,
+				GCancellable *cancellable,
+				GError **error)
+{
+	struct probe_batch batch = { NULL, NULL, NULL };
+	struct probe_entry *entry;
+	gboolean reachable = FALSE, shared;
+	GError *err = NULL;
+	gulong cancel_id = 0;
+	gint64 deadline;
+	guint16 port = 0;
+	char *host, *key;
+
+	if (probe == NULL)
+		return TRUE;
+
+	host = connectable_host(connectable, &port);
+	if (host == NULL || port == 0) {
+		/* Nothing sensible to connect to */
+		g_free(host);
+		return TRUE;
+	}
+
+	key = g_strdup_printf("%s:%u", host, port);
+	deadline = g_get_monotonic_time() + (gint64)timeout * 1000;
+
+	/* Waiting callers have to notice when they are cancelled */
+	if (cancellable != NULL)
+		cancel_id = g_cancellable_connect(cancellable,
+						G_CALLBACK(wake_up),
+						probe, NULL);
+
+	g_mutex_lock(&probe->lock);
+
+again:
+	entry = g_hash_table_lookup(probe->entries, key);
+	if (entry != NULL && entry->done == TRUE) {
+		reachable = entry_result(entry, &err);
+		goto done;
+	}
+
+	if (entry != NULL && entry->sync == TRUE) {
+		batch.unrefs = g_list_prepend(batch.unrefs, entry_ref(entry));
+
+		if (wait_locked(probe, entry, NULL, deadline, cancellable,
+							&err) == FALSE)
+			goto done;
+
+		/* The caller that ran the probe gave up or had less time */
+		if (g_error_matches(entry->error, G_IO_ERROR,
+					G_IO_ERROR_CANCELLED) == TRUE &&
+				g_cancellable_is_cancelled(cancellable) == FALSE)
+			goto again;
+
+		if (g_error_matches(entry->error, G_IO_ERROR,
+					G_IO_ERROR_TIMED_OUT) == TRUE &&
+				g_get_monotonic_time() < deadline)
+			goto again;
+
+		reachable = entry_result(entry, &err);
+		goto done;
+	}
+
+	/*
+	 * A probe run by a main loop may need this very thread to make
+	 * progress, so run a separate one instead of waiting for it.
+	 */
+	shared = entry == NULL;
+
+	entry = entry_new(probe, key, host, connectable, TRUE);
+	batch.unrefs = g_list_prepend(batch.unrefs, entry);
+
+	if (shared == TRUE)
+		g_hash_table_insert(probe->entries, g_strdup(key),
+							entry_ref(entry));
+
+	if (wait_locked(probe, NULL, host, deadline, cancellable,
+							&err) == FALSE) {
+		/* Running out of slots says nothing about the host */
+		entry_complete_locked(entry, FALSE, g_error_copy(err), FALSE,
+								&batch);
+		goto done;
+	}
+
+	slot_take(probe, entry);
+
+	g_mutex_unlock(&probe->lock);
+	probe_run(entry, deadline, cancellable);
+	g_mutex_lock(&probe->lock);
+
+	reachable = entry_result(entry, &err);
+
+done:
+	g_mutex_unlock(&probe->lock);
+
+	if (cancel_id != 0)
+		g_cancellable_disconnect(cancellable, cancel_id);
+
+	batch_run(&batch);
+
+	if (err != NULL)
+		g_propagate_error(error, err);
+
+	g_free(key);
+	g_free(host);
+
+	return reachable;
+}
+
+static void waiter_fail(struct probe_waiter *waiter, int code,
+				const char *message)
+{
+	struct probe_entry *entry = waiter->entry;
+	struct probe_batch batch = { NULL, NULL, NULL };
+	gboolean cancel = FALSE;
+
+	g_mutex_lock(&entry->probe->lock);
+
+	if (waiter->finished == TRUE) {
+		g_mutex_unlock(&entry->probe->lock);
+		return;
+	}
+
+	waiter_finish_locked(waiter, FALSE,
+				g_error_new_literal(G_IO_ERROR, code, message),
+				&batch);
+
+	/* Nobody is interested in the result anymore */
+	if (entry->waiters == NULL && entry->done == FALSE) {
+		if (entry->started == TRUE)
+			cancel = TRUE;
+		else
+			entry_complete_locked(entry, FALSE,
+					g_error_new_literal(G_IO_ERROR,
+						G_IO_ERROR_CANCELLED,
+						"Operation was cancelled"),
+					FALSE, &batch);
+	}
+
+	g_mutex_unlock(&entry->probe->lock);
+
+	if (cancel == TRUE)
+		g_cancellable_cancel(entry->cancellable);
+
+	batch_run(&batch);
+}
+
+static gboolean waiter_timeout(gpointer user_data)
+{
+	waiter_fail(user_data, G_IO_ERROR_TIMED_OUT, "Probe timed out");
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean waiter_cancelled(GCancellable *cancellable,
+					gpointer user_data)
+{
+	waiter_fail(user_data, G_IO_ERROR_CANCELLED,
+					"Operation was cancelled");
+
+	return G_SOURCE_REMOVE;
+}
+
+void connman_probe_can_reach_async(struct connman_probe *probe,
+				GSocketConnectable *connectable,
+				unsigned int timeout,
+				GCancellable *cancellable,
+				GAsyncReadyCallback callback,
+				gpointer user_data)
+{
+	struct probe_entry *entry;
+	struct probe_waiter *waiter;
+	gboolean start = FALSE;
+	GError *error = NULL;
+	GMainContext *context;
+	GTask *task;
+	guint16 port = 0;
+	char *host, *key;
+
+	task = g_task_new(NULL, cancellable, callback, user_data);
+
+	host = connectable_host(connectable, &port);
+	if (probe == NULL || host == NULL || port == 0) {
+		g_task_return_boolean(task, TRUE);
+		g_object_unref(task);
+		g_free(host);
+		return;
+	}
+
+	key = g_strdup_printf("%s:%u", host, port);
+	context = g_task_get_context(task);
+
+	g_mutex_lock(&probe->lock);
+
+	entry = g_hash_table_lookup(probe->entries, key);
+	if (entry != NULL && entry->done == TRUE) {
+		gboolean reachable = entry_result(entry, &error);
+
+		g_mutex_unlock(&probe->lock);
+
+		if (reachable == TRUE)
+			g_task_return_boolean(task, TRUE);
+		else
+			g_task_return_error(task, error);
+
+		g_object_unref(task);
+		goto done;
+	}
+
+	if (entry != NULL && entry->sync == FALSE)
+		entry_ref(entry);
+	else {
+		/* Probes of blocking callers are only shared among them */
+		gboolean shared = entry == NULL;
+
+		entry = entry_new(probe, key, host, connectable, FALSE);
+		entry->context = g_main_context_ref(context);
+
+		if (shared == TRUE)
+			g_hash_table_insert(probe->entries, g_strdup(key),
+							entry_ref(entry));
+
+		if (slot_free(probe, host) == TRUE) {
+			slot_take(probe, entry);
+			start = TRUE;
+		} else
+			g_queue_push_tail(&probe->queue, entry_ref(entry));
+	}
+
+	/* Every waiter has its own deadline, the probe runs for the last */
+	waiter = g_new0(struct probe_waiter, 1);
+	waiter->refcount = 1;
+	waiter->entry = entry;
+	waiter->task = task;
+
+	entry->waiters = g_list_append(entry->waiters, waiter);
+
+	waiter->timeout = g_timeout_source_new(timeout);
+	g_source_set_callback(waiter->timeout, waiter_timeout,
+					waiter_ref(waiter), waiter_unref);
+	g_source_attach(waiter->timeout, context);
+
+	if (cancellable != NULL) {
+		waiter->cancelled = g_cancellable_source_new(cancellable);
+		g_source_set_callback(waiter->cancelled,
+					(GSourceFunc)waiter_cancelled,
+					waiter_ref(waiter), waiter_unref);
+		g_source_attach(waiter->cancelled, context);
+	}
+
+	if (start == TRUE)
+		entry_ref(entry);
+
+	g_mutex_unlock(&probe->lock);
+
+	if (start == TRUE) {
+		probe_start(entry);
+		entry_unref(entry);
+	}
+
+done:
+	g_free(key);
+	g_free(host);
+}
+
+gboolean connman_probe_can_reach_finish(struct connman_probe *probe,
+					GAsyncResult *result,
+					GError **error)
+{
+	return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+void connman_probe_flush(struct connman_probe *probe)
+{
+	struct probe_batch batch = { NULL, NULL, NULL };
+	GHashTableIter iter;
+	gpointer value;
+
+	if (probe == NULL)
+		return;
+
+	DBG("");
+
+	/* Probes still running keep their entries alive until they end */
+	g_mutex_lock(&probe->lock);
+
+	g_hash_table_iter_init(&iter, probe->entries);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		batch.unrefs = g_list_prepend(batch.unrefs, value);
+		g_hash_table_iter_remove(&iter);
+	}
+
+	g_mutex_unlock(&probe->lock);
+
+	batch_run(&batch);
+}
+
+struct connman_probe *connman_probe_init(void)
+{
+	struct connman_probe *probe;
+
+	DBG("");
+
+	probe = g_try_malloc0(sizeof(struct connman_probe));
+	if (probe == NULL)
+		return NULL;
+
+	probe->refcount = 1;
+
+	g_mutex_init(&probe->lock);
+	g_cond_init(&probe->cond);
+	g_queue_init(&probe->queue);
+
+	probe->hosts = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, NULL);
+	probe->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, NULL);
+
+	return probe;
+}
+
+void connman_probe_cleanup(struct connman_probe *probe)
+{
+	struct probe_batch batch = { NULL, NULL, NULL };
+	struct probe_entry *entry;
+	GList *running = NULL, *list;
+	GHashTableIter iter;
+	gpointer value;
+
+	if (probe == NULL)
+		return;
+
+	DBG("");
+
+	g_mutex_lock(&probe->lock);
+
+	/* Queued probes never start, running ones are cancelled */
+	while ((entry = g_queue_peek_head(&probe->queue)) != NULL)
+		entry_complete_locked(entry, FALSE,
+				g_error_new_literal(G_IO_ERROR,
+						G_IO_ERROR_CANCELLED,
+						"Operation was cancelled"),
+				FALSE, &batch);
+
+	g_hash_table_iter_init(&iter, probe->entries);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		entry = value;
+
+		if (entry->done == FALSE)
+			running = g_list_prepend(running, entry_ref(entry));
+
+		batch.unrefs = g_list_prepend(batch.unrefs, entry);
+		g_hash_table_iter_remove(&iter);
+	}
+
+	g_mutex_unlock(&probe->lock);
+
+	for (list = running; list != NULL; list = list->next) {
+		entry = list->data;
+		g_cancellable_cancel(entry->cancellable);
+	}
+
+	g_list_free_full(running, entry_unref);
+
+	batch_run(&batch);
+
+	/* Probes that are still running hold on to the probe */
+	probe_unref(probe);
+}
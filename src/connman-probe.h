@@ -0,0 +1,51 @@
+/*
+ *
+ *  Network Monitor for Connection Manager
+ *
+ *  Copyright (C) 2012  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License version 2.1,
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+struct connman_probe;
+
+struct connman_probe *connman_probe_init(void);
+
+void connman_probe_cleanup(struct connman_probe *probe);
+
+/* Forget the cached results, called whenever the network changes */
+void connman_probe_flush(struct connman_probe *probe);
+
+/*
+ * Connects to the target over TCP within timeout milliseconds, name
+ * lookup included. Callers asking for the same host and port at the
+ * same time share one probe, blocking callers only with each other.
+ */
+gboolean connman_probe_can_reach(struct connman_probe *probe,
+				GSocketConnectable *connectable,
+				unsigned int timeout,
+				GCancellable *cancellable,
+				GError **error);
+
+/* Runs the probe in the thread default main context */
+void connman_probe_can_reach_async(struct connman_probe *probe,
+				GSocketConnectable *connectable,
+				unsigned int timeout,
+				GCancellable *cancellable,
+				GAsyncReadyCallback callback,
+				gpointer user_data);
+gboolean connman_probe_can_reach_finish(struct connman_probe *probe,
+					GAsyncResult *result,
+					GError **error);
@@ -0,0 +1,586 @@
+/*
+ *
+ *  Network Monitor for Connection Manager
+ *
+ *  Copyright (C) 2012  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License version 2.1,
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <gio/gio.h>
+
+#include "connman-api.h"
+#include "connman-vpn.h"
+#include "connman-proxy.h"
+
+enum proxy_method {
+	PROXY_METHOD_DIRECT = 0,
+	PROXY_METHOD_MANUAL,
+	PROXY_METHOD_AUTO,
+};
+
+struct proxy_network {
+	GSocketFamily family;
+	guint8 address[16];
+	unsigned int prefix;
+};
+
+/* Never changed once built, lookups share it through a reference */
+struct proxy_config {
+	gint refcount;
+	enum proxy_method method;
+	char *url;
+	GPtrArray *servers;
+	GHashTable *protocol_servers;
+	GHashTable *excluded_domains;
+	GArray *excluded_networks;
+};
+
+typedef struct _GProxyResolverConnmanPrivate GProxyResolverConnmanPrivate;
+struct _GProxyResolverConnmanPrivate
+{
+	GMutex lock;
+	struct proxy_config *config;
+};
+
+typedef struct _GProxyResolverConnman GProxyResolverConnman;
+struct _GProxyResolverConnman {
+	GObject parent;
+	GProxyResolverConnmanPrivate *priv;
+};
+
+typedef struct _GProxyResolverConnmanClass GProxyResolverConnmanClass;
+struct _GProxyResolverConnmanClass {
+	GObjectClass parent_class;
+};
+
+#define CONNMAN_PROXY_RESOLVER(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+					CONNMAN_TYPE_PROXY_RESOLVER,   \
+					GProxyResolverConnman))
+
+static void proxy_resolver_iface_init(GProxyResolverInterface *iface);
+static void g_proxy_resolver_connman_init(GProxyResolverConnman *self);
+static void g_proxy_resolver_connman_class_init(GProxyResolverConnmanClass *klass);
+static void g_proxy_resolver_connman_class_finalize(GProxyResolverConnmanClass *klass);
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED(GProxyResolverConnman,
+			g_proxy_resolver_connman,
+			G_TYPE_OBJECT, 0  /* flags */,
+			G_IMPLEMENT_INTERFACE_DYNAMIC(G_TYPE_PROXY_RESOLVER,
+				proxy_resolver_iface_init))
+
+static guint host_hash(gconstpointer key)
+{
+	const char *p;
+	guint hash = 5381;
+
+	for (p = key; *p != '\0'; p++)
+		hash = hash * 33 + g_ascii_tolower(*p);
+
+	return hash;
+}
+
+static gboolean host_equal(gconstpointer a, gconstpointer b)
+{
+	return g_ascii_strcasecmp(a, b) == 0;
+}
+
+static void config_unref(struct proxy_config *config)
+{
+	if (g_atomic_int_dec_and_test(&config->refcount) == FALSE)
+		return;
+
+	g_free(config->url);
+	g_ptr_array_unref(config->servers);
+	g_hash_table_destroy(config->protocol_servers);
+	g_hash_table_destroy(config->excluded_domains);
+	g_array_free(config->excluded_networks, TRUE);
+	g_free(config);
+}
+
+static void compile_exclude(struct proxy_config *config, const char *exclude)
+{
+	struct proxy_network network;
+	const char *slash;
+	GInetAddress *addr;
+	char *address;
+	gsize size;
+	int prefix;
+
+	slash = strchr(exclude, '/');
+	if (slash != NULL)
+		address = g_strndup(exclude, slash - exclude);
+	else
+		address = g_strdup(exclude);
+
+	addr = g_inet_address_new_from_string(address);
+	g_free(address);
+
+	if (addr == NULL) {
+		/*
+		 * "example.com", ".example.com" and "*.example.com" all
+		 * match the domain and every subdomain of it.
+		 */
+		if (exclude[0] == '*')
+			exclude++;
+		if (exclude[0] == '.')
+			exclude++;
+
+		if (exclude[0] != '\0')
+			g_hash_table_add(config->excluded_domains,
+						g_strdup(exclude));
+		return;
+	}
+
+	memset(&network, 0, sizeof(network));
+	network.family = g_inet_address_get_family(addr);
+	size = g_inet_address_get_native_size(addr);
+	memcpy(network.address, g_inet_address_to_bytes(addr), size);
+
+	g_object_unref(addr);
+
+	prefix = slash != NULL ? connman_netmask2prefix(slash + 1) :
+							(int)size * 8;
+	if (prefix < 0 || prefix > (int)size * 8) {
+		DBG("invalid exclude %s", exclude);
+		return;
+	}
+
+	network.prefix = prefix;
+
+	g_array_append_val(config->excluded_networks, network);
+}
+
+/*
+ * A server with a protocol is used only for URIs of that protocol,
+ * one without is used for the rest. The proxy itself speaks HTTP in
+ * both cases, only SOCKS servers are named by their own protocol.
+ */
+static void compile_server(struct proxy_config *config, const char *server)
+{
+	GPtrArray *servers;
+	const char *sep;
+	char *protocol;
+
+	sep = strstr(server, "://");
+	if (sep == NULL) {
+		g_ptr_array_add(config->servers,
+				g_strconcat("http://", server, NULL));
+		return;
+	}
+
+	if (g_ascii_strncasecmp(server, "socks", 5) == 0) {
+		g_ptr_array_add(config->servers, g_strdup(server));
+		return;
+	}
+
+	if (sep == server || sep[3] == '\0') {
+		DBG("invalid server %s", server);
+		return;
+	}
+
+	protocol = g_ascii_strdown(server, sep - server);
+
+	servers = g_hash_table_lookup(config->protocol_servers, protocol);
+	if (servers == NULL) {
+		servers = g_ptr_array_new_with_free_func(g_free);
+		g_hash_table_insert(config->protocol_servers, protocol,
+								servers);
+	} else
+		g_free(protocol);
+
+	g_ptr_array_add(servers, g_strconcat("http://", sep + 3, NULL));
+}
+
+static struct proxy_config *config_new(GVariant *settings)
+{
+	struct proxy_config *config;
+	const char *method = NULL;
+	const char **servers = NULL;
+	const char **excludes = NULL;
+	unsigned int i;
+
+	config = g_new0(struct proxy_config, 1);
+	config->refcount = 1;
+	config->servers = g_ptr_array_new_with_free_func(g_free);
+	config->protocol_servers = g_hash_table_new_full(g_str_hash,
+					g_str_equal, g_free,
+					(GDestroyNotify) g_ptr_array_unref);
+	config->excluded_domains = g_hash_table_new_full(host_hash, host_equal,
+								g_free, NULL);
+	config->excluded_networks = g_array_new(FALSE, FALSE,
+						sizeof(struct proxy_network));
+
+	if (settings == NULL ||
+		g_variant_is_of_type(settings, G_VARIANT_TYPE_VARDICT) == FALSE)
+		return config;
+
+	g_variant_lookup(settings, "Method", "&s", &method);
+
+	DBG("method %s", method);
+
+	if (g_strcmp0(method, "auto") == 0) {
+		config->method = PROXY_METHOD_AUTO;
+		g_variant_lookup(settings, "URL", "s", &config->url);
+		return config;
+	}
+
+	if (g_strcmp0(method, "manual") != 0)
+		return config;
+
+	config->method = PROXY_METHOD_MANUAL;
+
+	g_variant_lookup(settings, "Servers", "^a&s", &servers);
+
+	for (i = 0; servers != NULL && servers[i]; i++)
+		compile_server(config, servers[i]);
+
+	g_free(servers);
+
+	g_variant_lookup(settings, "Excludes", "^a&s", &excludes);
+
+	for (i = 0; excludes != NULL && excludes[i]; i++)
+		compile_exclude(config, excludes[i]);
+
+	g_free(excludes);
+
+	return config;
+}
+
+static gboolean networks_match(GArray *networks, GSocketFamily family,
+				const guint8 *bytes)
+{
+	struct proxy_network *network;
+	unsigned int i, full, rest;
+	guint8 mask;
+
+	for (i = 0; i < networks->len; i++) {
+		network = &g_array_index(networks, struct proxy_network, i);
+
+		if (network->family != family)
+			continue;
+
+		full = network->prefix / 8;
+		rest = network->prefix % 8;
+
+		if (memcmp(network->address, bytes, full) != 0)
+			continue;
+
+		if (rest == 0)
+			return TRUE;
+
+		mask = 0xff << (8 - rest);
+		if ((network->address[full] & mask) == (bytes[full] & mask))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Parsed in place, lookups for literal addresses allocate nothing */
+static gboolean parse_address(const char *host, GSocketFamily *family,
+				guint8 *bytes)
+{
+	if (inet_pton(AF_INET, host, bytes) == 1) {
+		*family = G_SOCKET_FAMILY_IPV4;
+		return TRUE;
+	}
+
+	if (inet_pton(AF_INET6, host, bytes) == 1) {
+		*family = G_SOCKET_FAMILY_IPV6;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean is_loopback(GSocketFamily family, const guint8 *bytes)
+{
+	static const guint8 loopback6[16] = { [15] = 1 };
+
+	if (family == G_SOCKET_FAMILY_IPV4)
+		return bytes[0] == 127;
+
+	return memcmp(bytes, loopback6, sizeof(loopback6)) == 0;
+}
+
+static gboolean config_is_direct(struct proxy_config *config,
+				const char *host)
+{
+	GSocketFamily family;
+	guint8 bytes[16];
+	const char *domain;
+
+	/* Local connections never go through a proxy */
+	if (g_ascii_strcasecmp(host, "localhost") == 0)
+		return TRUE;
+
+	if (parse_address(host, &family, bytes) == TRUE)
+		return is_loopback(family, bytes) == TRUE ||
+			networks_match(config->excluded_networks,
+						family, bytes) == TRUE;
+
+	for (domain = host; domain != NULL; domain = strchr(domain, '.')) {
+		if (domain[0] == '.')
+			domain++;
+
+		if (g_hash_table_contains(config->excluded_domains,
+							domain) == TRUE)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean uri_host(const char *uri, char *host, gsize size)
+{
+	const char *start, *end, *p;
+	gsize len;
+
+	start = strstr(uri, "://");
+	if (start == NULL)
+		return FALSE;
+
+	start += 3;
+	end = start + strcspn(start, "/?#");
+
+	/* Skip the user info */
+	for (p = start; p < end; p++) {
+		if (*p == '@')
+			start = p + 1;
+	}
+
+	if (*start == '[') {
+		start++;
+		p = memchr(start, ']', end - start);
+		if (p == NULL)
+			return FALSE;
+	} else
+		p = memchr(start, ':', end - start);
+
+	if (p != NULL)
+		end = p;
+
+	len = end - start;
+	if (len == 0 || len >= size)
+		return FALSE;
+
+	memcpy(host, start, len);
+	host[len] = '\0';
+
+	return TRUE;
+}
+
+static gchar **config_lookup(struct proxy_config *config, const char *uri)
+{
+	GPtrArray *servers = NULL;
+	gchar **proxies;
+	char protocol[32], host[256];
+	const char *sep;
+	unsigned int i;
+
+	if (config->method != PROXY_METHOD_MANUAL)
+		goto direct;
+
+	sep = strstr(uri, "://");
+	if (sep != NULL && sep > uri && sep - uri < (int)sizeof(protocol)) {
+		for (i = 0; uri + i < sep; i++)
+			protocol[i] = g_ascii_tolower(uri[i]);
+		protocol[i] = '\0';
+
+		servers = g_hash_table_lookup(config->protocol_servers,
+								protocol);
+	}
+
+	if (servers == NULL)
+		servers = config->servers;
+
+	if (servers->len == 0)
+		goto direct;
+
+	if (uri_host(uri, host, sizeof(host)) == TRUE &&
+			config_is_direct(config, host) == TRUE)
+		goto direct;
+
+	proxies = g_new0(gchar *, servers->len + 1);
+	for (i = 0; i < servers->len; i++)
+		proxies[i] = g_strdup(g_ptr_array_index(servers, i));
+
+	return proxies;
+
+direct:
+	proxies = g_new0(gchar *, 2);
+	proxies[0] = g_strdup("direct://");
+
+	return proxies;
+}
+
+static struct proxy_config *get_config(GProxyResolverConnman *self)
+{
+	struct proxy_config *config;
+
+	g_mutex_lock(&self->priv->lock);
+	config = self->priv->config;
+	g_atomic_int_inc(&config->refcount);
+	g_mutex_unlock(&self->priv->lock);
+
+	return config;
+}
+
+static gboolean proxy_is_supported(GProxyResolver *resolver)
+{
+	return TRUE;
+}
+
+/* PAC files are not evaluated, callers get an error instead of a guess */
+static gboolean config_check(struct proxy_config *config, GError **error)
+{
+	if (config->method != PROXY_METHOD_AUTO)
+		return TRUE;
+
+	g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			"Automatic proxy configuration from %s is not "
+			"supported", config->url != NULL ? config->url :
+							"the network");
+
+	return FALSE;
+}
+
+static gchar **proxy_lookup(GProxyResolver *resolver, const gchar *uri,
+				GCancellable *cancellable, GError **error)
+{
+	GProxyResolverConnman *self = CONNMAN_PROXY_RESOLVER(resolver);
+	struct proxy_config *config;
+	gchar **proxies = NULL;
+
+	config = get_config(self);
+
+	if (config_check(config, error) == TRUE)
+		proxies = config_lookup(config, uri);
+
+	config_unref(config);
+
+	return proxies;
+}
+
+static void proxy_lookup_async(GProxyResolver *resolver, const gchar *uri,
+				GCancellable *cancellable,
+				GAsyncReadyCallback callback,
+				gpointer user_data)
+{
+	GProxyResolverConnman *self = CONNMAN_PROXY_RESOLVER(resolver);
+	struct proxy_config *config;
+	GError *error = NULL;
+	GTask *task;
+
+	task = g_task_new(resolver, cancellable, callback, user_data);
+	config = get_config(self);
+
+	if (config_check(config, &error) == TRUE)
+		g_task_return_pointer(task, config_lookup(config, uri),
+					(GDestroyNotify) g_strfreev);
+	else
+		g_task_return_error(task, error);
+
+	config_unref(config);
+	g_object_unref(task);
+}
+
+static gchar **proxy_lookup_finish(GProxyResolver *resolver,
+				GAsyncResult *result, GError **error)
+{
+	return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+static void proxy_resolver_iface_init(GProxyResolverInterface *iface)
+{
+	iface->is_supported = proxy_is_supported;
+	iface->lookup = proxy_lookup;
+	iface->lookup_async = proxy_lookup_async;
+	iface->lookup_finish = proxy_lookup_finish;
+}
+
+static void proxy_resolver_finalize(GObject *object)
+{
+	GProxyResolverConnman *self = CONNMAN_PROXY_RESOLVER(object);
+
+	config_unref(self->priv->config);
+	self->priv->config = NULL;
+
+	g_mutex_clear(&self->priv->lock);
+
+	G_OBJECT_CLASS(g_proxy_resolver_connman_parent_class)->
+					finalize(object);
+}
+
+static void
+g_proxy_resolver_connman_class_init(GProxyResolverConnmanClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+	gobject_class->finalize = proxy_resolver_finalize;
+
+	g_type_class_add_private(gobject_class,
+				sizeof(GProxyResolverConnmanPrivate));
+}
+
+static void
+g_proxy_resolver_connman_class_finalize(GProxyResolverConnmanClass *klass)
+{
+}
+
+static void g_proxy_resolver_connman_init(GProxyResolverConnman *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
+						CONNMAN_TYPE_PROXY_RESOLVER,
+						GProxyResolverConnmanPrivate);
+
+	g_mutex_init(&self->priv->lock);
+	self->priv->config = config_new(NULL);
+}
+
+void connman_proxy_register_type(GTypeModule *module)
+{
+	g_proxy_resolver_connman_register_type(module);
+}
+
+GProxyResolver *connman_proxy_resolver_new(void)
+{
+	return g_object_new(CONNMAN_TYPE_PROXY_RESOLVER, NULL);
+}
+
+void connman_proxy_resolver_update(GProxyResolver *resolver,
+					GVariant *settings)
+{
+	GProxyResolverConnman *self;
+	struct proxy_config *config, *old;
+
+	if (resolver == NULL)
+		return;
+
+	self = CONNMAN_PROXY_RESOLVER(resolver);
+	config = config_new(settings);
+
+	g_mutex_lock(&self->priv->lock);
+	old = self->priv->config;
+	self->priv->config = config;
+	g_mutex_unlock(&self->priv->lock);
+
+	config_unref(old);
+}
@@ -0,0 +1,32 @@
+/*
+ *
+ *  Network Monitor for Connection Manager
+ *
+ *  Copyright (C) 2012  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License version 2.1,
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define CONNMAN_TYPE_PROXY_RESOLVER (g_proxy_resolver_connman_get_type())
+
+GType g_proxy_resolver_connman_get_type(void);
+
+void connman_proxy_register_type(GTypeModule *module);
+
+GProxyResolver *connman_proxy_resolver_new(void);
+
+/* Settings are the Proxy dictionary of the default service or NULL */
+void connman_proxy_resolver_update(GProxyResolver *resolver,
+					GVariant *settings);
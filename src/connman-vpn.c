@@ -0,0 +1,822 @@
+/*
+ *
+ *  Network Monitor for Connection Manager
+ *
+ *  Copyright (C) 2012  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License version 2.1,
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "connman-api.h"
+#include "connman-vpn.h"
+
+#define VPN_DBUS_NAME "net.connman.vpn"
+
+#define VPN_MANAGER_PATH "/"
+#define VPN_MANAGER_INTERFACE VPN_DBUS_NAME ".Manager"
+#define VPN_CONNECTION_INTERFACE VPN_DBUS_NAME ".Connection"
+
+/*
+ * Shorter routes, such as 0.0.0.0/1 with 128.0.0.0/1, take over the
+ * default route instead of splitting the traffic.
+ */
+#define ROUTE_MIN_PREFIX 8
+
+struct vpn_route {
+	GSocketFamily family;
+	guint8 network[16];
+	unsigned int prefix;
+};
+
+struct vpn_connection {
+	gboolean connected;
+	GArray *user_routes;
+	GArray *server_routes;
+};
+
+struct connman_vpn {
+	GDBusConnection *connection;
+	guint vpn_watch;
+	guint connection_added_watch;
+	guint connection_removed_watch;
+	guint property_changed_watch;
+	connman_vpn_changed_cb changed_cb;
+	void *user_data;
+	GHashTable *connections;
+	GArray *blocked;
+	GArray *allowed;
+	GArray *local;
+	GCancellable *pending;
+};
+
+static GArray *routes_new(void)
+{
+	return g_array_new(FALSE, FALSE, sizeof(struct vpn_route));
+}
+
+static void connection_free(gpointer data)
+{
+	struct vpn_connection *conn = data;
+
+	g_array_free(conn->user_routes, TRUE);
+	g_array_free(conn->server_routes, TRUE);
+	g_free(conn);
+}
+
+int connman_netmask2prefix(const char *netmask)
+{
+	GInetAddress *mask;
+	const guint8 *bytes;
+	int prefix = 0;
+	gsize i, len;
+
+	/* IPv6 routes carry a prefix length instead of a netmask */
+	if (strchr(netmask, '.') == NULL && strchr(netmask, ':') == NULL) {
+		char *end;
+		long value;
+
+		errno = 0;
+		value = strtol(netmask, &end, 10);
+		if (end == netmask || *end != '\0' || errno != 0 ||
+				value < 0 || value > 128)
+			return -EINVAL;
+
+		return value;
+	}
+
+	mask = g_inet_address_new_from_string(netmask);
+	if (mask == NULL)
+		return -EINVAL;
+
+	bytes = g_inet_address_to_bytes(mask);
+	len = g_inet_address_get_native_size(mask);
+
+	for (i = 0; i < len; i++) {
+		guint8 byte = bytes[i];
+
+		while (byte & 0x80) {
+			prefix++;
+			byte <<= 1;
+		}
+
+		if (bytes[i] != 0xff)
+			break;
+	}
+
+	/* Only contiguous masks describe a network */
+	for (i = 0; i < len && prefix >= 0; i++) {
+		guint8 expected;
+
+		if (prefix >= (int)(i + 1) * 8)
+			expected = 0xff;
+		else if (prefix <= (int)i * 8)
+			expected = 0;
+		else
+			expected = 0xff << (8 - (prefix - i * 8));
+
+		if (bytes[i] != expected)
+			prefix = -EINVAL;
+	}
+
+	g_object_unref(mask);
+
+	return prefix;
+}
+
+static gboolean route_parse(struct vpn_route *route, const char *network,
+				const char *netmask)
+{
+	GInetAddress *addr;
+	gsize size;
+	int prefix;
+
+	addr = g_inet_address_new_from_string(network);
+	if (addr == NULL)
+		return FALSE;
+
+	memset(route, 0, sizeof(*route));
+	route->family = g_inet_address_get_family(addr);
+	size = g_inet_address_get_native_size(addr);
+	memcpy(route->network, g_inet_address_to_bytes(addr), size);
+
+	g_object_unref(addr);
+
+	prefix = netmask != NULL ? connman_netmask2prefix(netmask) : (int)size * 8;
+	if (prefix < 0 || prefix > (int)size * 8) {
+		DBG("invalid netmask %s for %s", netmask, network);
+		return FALSE;
+	}
+
+	route->prefix = prefix;
+
+	return TRUE;
+}
+
+static void parse_route(GArray *routes, GVariant *dict)
+{
+	const char *network = NULL, *netmask = NULL;
+	struct vpn_route route;
+
+	if (g_variant_is_of_type(dict, G_VARIANT_TYPE_VARDICT) == FALSE)
+		return;
+
+	g_variant_lookup(dict, "Network", "&s", &network);
+	g_variant_lookup(dict, "Netmask", "&s", &netmask);
+
+	if (network == NULL)
+		return;
+
+	if (route_parse(&route, network, netmask) == FALSE)
+		return;
+
+	if (route.prefix < ROUTE_MIN_PREFIX) {
+		DBG("ignoring default route like %s/%u", network, route.prefix);
+		return;
+	}
+
+	g_array_append_val(routes, route);
+}
+
+static GArray *parse_routes(GVariant *value)
+{
+	GArray *routes = routes_new();
+	GVariant *child, *dict;
+	GVariantIter iter;
+
+	if (g_variant_is_of_type(value, G_VARIANT_TYPE_ARRAY) == FALSE)
+		return routes;
+
+	g_variant_iter_init(&iter, value);
+
+	/* Each route is a dictionary, possibly wrapped in a struct */
+	while ((child = g_variant_iter_next_value(&iter)) != NULL) {
+		if (g_variant_is_of_type(child, G_VARIANT_TYPE_TUPLE) == TRUE)
+			dict = g_variant_get_child_value(child, 0);
+		else
+			dict = g_variant_ref(child);
+
+		parse_route(routes, dict);
+
+		g_variant_unref(dict);
+		g_variant_unref(child);
+	}
+
+	return routes;
+}
+
+static void connection_update(struct vpn_connection *conn,
+				const char *key, GVariant *value)
+{
+	if (g_str_equal(key, "State") == TRUE) {
+		conn->connected = g_strcmp0(g_variant_get_string(value, NULL),
+						"ready") == 0;
+	} else if (g_str_equal(key, "UserRoutes") == TRUE) {
+		g_array_free(conn->user_routes, TRUE);
+		conn->user_routes = parse_routes(value);
+	} else if (g_str_equal(key, "ServerRoutes") == TRUE) {
+		g_array_free(conn->server_routes, TRUE);
+		conn->server_routes = parse_routes(value);
+	}
+}
+
+static void connection_add(struct connman_vpn *vpn, const char *path,
+				GVariant *properties)
+{
+	struct vpn_connection *conn;
+	GVariantIter iter;
+	GVariant *value;
+	const char *key;
+
+	DBG("connection %s", path);
+
+	conn = g_new0(struct vpn_connection, 1);
+	conn->user_routes = routes_new();
+	conn->server_routes = routes_new();
+
+	g_hash_table_replace(vpn->connections, g_strdup(path), conn);
+
+	g_variant_iter_init(&iter, properties);
+	while (g_variant_iter_loop(&iter, "{&sv}", &key, &value))
+		connection_update(conn, key, value);
+}
+
+static gboolean routes_equal(GArray *a, GArray *b)
+{
+	if (a->len != b->len)
+		return FALSE;
+
+	return memcmp(a->data, b->data,
+			a->len * sizeof(struct vpn_route)) == 0;
+}
+
+static void update_routes(struct connman_vpn *vpn)
+{
+	struct vpn_connection *conn;
+	GArray *blocked, *allowed, *routes;
+	GHashTableIter iter;
+	gpointer value;
+	gboolean changed;
+
+	blocked = routes_new();
+	allowed = routes_new();
+
+	/*
+	 * Full tunnels have no routes of their own and do not affect
+	 * anything, so only split tunnels end up in these sets.
+	 */
+	g_hash_table_iter_init(&iter, vpn->connections);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		conn = value;
+		routes = conn->connected == TRUE ? allowed : blocked;
+
+		g_array_append_vals(routes, conn->user_routes->data,
+					conn->user_routes->len);
+		g_array_append_vals(routes, conn->server_routes->data,
+					conn->server_routes->len);
+	}
+
+	changed = routes_equal(blocked, vpn->blocked) == FALSE ||
+			routes_equal(allowed, vpn->allowed) == FALSE;
+
+	g_array_free(vpn->blocked, TRUE);
+	g_array_free(vpn->allowed, TRUE);
+	vpn->blocked = blocked;
+	vpn->allowed = allowed;
+
+	DBG("blocked %u allowed %u changed %d", blocked->len, allowed->len,
+								changed);
+
+	if (changed == TRUE && vpn->changed_cb != NULL)
+		vpn->changed_cb(vpn->user_data);
+}
+
+static gboolean routes_match(GArray *routes, GSocketFamily family,
+				const guint8 *bytes)
+{
+	struct vpn_route *route;
+	unsigned int i, full, rest;
+	guint8 mask;
+
+	for (i = 0; i < routes->len; i++) {
+		route = &g_array_index(routes, struct vpn_route, i);
+
+		if (route->family != family)
+			continue;
+
+		full = route->prefix / 8;
+		rest = route->prefix % 8;
+
+		if (memcmp(route->network, bytes, full) != 0)
+			continue;
+
+		if (rest == 0)
+			return TRUE;
+
+		mask = 0xff << (8 - rest);
+		if ((route->network[full] & mask) == (bytes[full] & mask))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean is_blocked(struct connman_vpn *vpn, GInetAddress *address)
+{
+	GSocketFamily family = g_inet_address_get_family(address);
+	const guint8 *bytes = g_inet_address_to_bytes(address);
+
+	/* Hosts on the network of the default service are reached directly */
+	if (routes_match(vpn->local, family, bytes) == TRUE)
+		return FALSE;
+
+	if (routes_match(vpn->blocked, family, bytes) == FALSE)
+		return FALSE;
+
+	/* Another VPN that is up might still route it */
+	return routes_match(vpn->allowed, family, bytes) == FALSE;
+}
+
+static void local_add(GArray *local, const char *network)
+{
+	struct vpn_route route;
+	char **parts;
+
+	if (network == NULL)
+		return;
+
+	parts = g_strsplit(network, "/", 2);
+
+	if (route_parse(&route, parts[0], parts[1]) == TRUE)
+		g_array_append_val(local, route);
+
+	g_strfreev(parts);
+}
+
+void connman_vpn_set_local_networks(struct connman_vpn *vpn,
+					const char *ipv4, const char *ipv6)
+{
+	GArray *local;
+	gboolean changed;
+
+	if (vpn == NULL)
+		return;
+
+	DBG("ipv4 %s ipv6 %s", ipv4, ipv6);
+
+	local = routes_new();
+	local_add(local, ipv4);
+	local_add(local, ipv6);
+
+	changed = routes_equal(local, vpn->local) == FALSE;
+
+	g_array_free(vpn->local, TRUE);
+	vpn->local = local;
+
+	/* Only matters when some hosts are blocked */
+	if (changed == TRUE && vpn->blocked->len > 0 &&
+						vpn->changed_cb != NULL)
+		vpn->changed_cb(vpn->user_data);
+}
+
+gboolean connman_vpn_can_reach(struct connman_vpn *vpn,
+				GSocketConnectable *connectable,
+				GCancellable *cancellable)
+{
+	GSocketAddressEnumerator *enumerator;
+	GSocketAddress *addr;
+	gboolean found = FALSE, reachable = FALSE;
+
+	if (vpn == NULL || vpn->blocked->len == 0)
+		return TRUE;
+
+	enumerator = g_socket_connectable_enumerate(connectable);
+
+	while (reachable == FALSE) {
+		addr = g_socket_address_enumerator_next(enumerator,
+							cancellable, NULL);
+		if (addr == NULL)
+			break;
+
+		if (G_IS_INET_SOCKET_ADDRESS(addr)) {
+			GInetAddress *iaddr;
+
+			iaddr = g_inet_socket_address_get_address(
+						G_INET_SOCKET_ADDRESS(addr));
+
+			found = TRUE;
+			reachable = is_blocked(vpn, iaddr) == FALSE;
+		}
+
+		g_object_unref(addr);
+	}
+
+	g_object_unref(enumerator);
+
+	/* Let the caller find out if the name cannot be resolved at all */
+	if (found == FALSE)
+		return TRUE;
+
+	return reachable;
+}
+
+struct reach_data {
+	struct connman_vpn *vpn;
+	GSocketAddressEnumerator *enumerator;
+	gboolean found;
+};
+
+static void reach_data_free(gpointer data)
+{
+	struct reach_data *reach = data;
+
+	g_object_unref(reach->enumerator);
+	g_free(reach);
+}
+
+static void reach_next_callback(GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	GTask *task = user_data;
+	struct reach_data *reach = g_task_get_task_data(task);
+	GSocketAddress *addr;
+	GError *error = NULL;
+
+	addr = g_socket_address_enumerator_next_finish(reach->enumerator,
+							res, &error);
+	if (addr == NULL) {
+		if (g_error_matches(error, G_IO_ERROR,
+					G_IO_ERROR_CANCELLED) == TRUE)
+			g_task_return_error(task, error);
+		else {
+			g_clear_error(&error);
+			/* Every address found so far is blocked */
+			g_task_return_boolean(task, reach->found == FALSE);
+		}
+
+		g_object_unref(task);
+		return;
+	}
+
+	if (G_IS_INET_SOCKET_ADDRESS(addr)) {
+		GInetAddress *iaddr;
+
+		iaddr = g_inet_socket_address_get_address(
+					G_INET_SOCKET_ADDRESS(addr));
+
+		reach->found = TRUE;
+
+		if (is_blocked(reach->vpn, iaddr) == FALSE) {
+			g_object_unref(addr);
+			g_task_return_boolean(task, TRUE);
+			g_object_unref(task);
+			return;
+		}
+	}
+
+	g_object_unref(addr);
+
+	g_socket_address_enumerator_next_async(reach->enumerator,
+						g_task_get_cancellable(task),
+						reach_next_callback, task);
+}
+
+void connman_vpn_can_reach_async(struct connman_vpn *vpn,
+				GSocketConnectable *connectable,
+				GCancellable *cancellable,
+				GAsyncReadyCallback callback,
+				gpointer user_data)
+{
+	struct reach_data *reach;
+	GTask *task;
+
+	task = g_task_new(NULL, cancellable, callback, user_data);
+
+	if (vpn == NULL || vpn->blocked->len == 0) {
+		g_task_return_boolean(task, TRUE);
+		g_object_unref(task);
+		return;
+	}
+
+	reach = g_new0(struct reach_data, 1);
+	reach->vpn = vpn;
+	reach->enumerator = g_socket_connectable_enumerate(connectable);
+	g_task_set_task_data(task, reach, reach_data_free);
+
+	g_socket_address_enumerator_next_async(reach->enumerator, cancellable,
+						reach_next_callback, task);
+}
+
+gboolean connman_vpn_can_reach_finish(struct connman_vpn *vpn,
+					GAsyncResult *result,
+					GError **error)
+{
+	return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+static void get_connections_callback(GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	struct connman_vpn *vpn = user_data;
+	GVariant *reply, *connections, *properties;
+	GError *error = NULL;
+	GVariantIter iter;
+	const char *path;
+
+	DBG("");
+
+	reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object),
+						res, &error);
+	if (reply == NULL && g_error_matches(error, G_IO_ERROR,
+					G_IO_ERROR_CANCELLED) == TRUE) {
+		g_error_free(error);
+		return;
+	}
+
+	g_object_unref(vpn->pending);
+	vpn->pending = NULL;
+
+	if (reply == NULL) {
+		DBG("%s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	g_variant_get(reply, "(@a(oa{sv}))", &connections);
+
+	g_hash_table_remove_all(vpn->connections);
+
+	g_variant_iter_init(&iter, connections);
+	while (g_variant_iter_loop(&iter, "(&o@a{sv})", &path, &properties))
+		connection_add(vpn, path, properties);
+
+	update_routes(vpn);
+
+	g_variant_unref(connections);
+	g_variant_unref(reply);
+}
+
+static void get_connections(struct connman_vpn *vpn)
+{
+	DBG("");
+
+	if (vpn->pending != NULL) {
+		g_cancellable_cancel(vpn->pending);
+		g_object_unref(vpn->pending);
+	}
+
+	vpn->pending = g_cancellable_new();
+	g_dbus_connection_call(vpn->connection,
+				VPN_DBUS_NAME,
+				VPN_MANAGER_PATH,
+				VPN_MANAGER_INTERFACE,
+				"GetConnections",
+				NULL,
+				G_VARIANT_TYPE("(a(oa{sv}))"),
+				G_DBUS_CALL_FLAGS_NONE,
+				-1,
+				vpn->pending,
+				get_connections_callback,
+				vpn);
+}
+
+static void connection_added_signal_cb(GDBusConnection *connection,
+					const gchar *sender_name,
+					const gchar *object_path,
+					const gchar *interface_name,
+					const gchar *signal_name,
+					GVariant *parameters,
+					gpointer user_data)
+{
+	struct connman_vpn *vpn = user_data;
+	GVariant *properties;
+	const char *path;
+
+	g_variant_get(parameters, "(&o@a{sv})", &path, &properties);
+
+	connection_add(vpn, path, properties);
+	update_routes(vpn);
+
+	g_variant_unref(properties);
+}
+
+static void connection_removed_signal_cb(GDBusConnection *connection,
+					const gchar *sender_name,
+					const gchar *object_path,
+					const gchar *interface_name,
+					const gchar *signal_name,
+					GVariant *parameters,
+					gpointer user_data)
+{
+	struct connman_vpn *vpn = user_data;
+	const char *path;
+
+	g_variant_get(parameters, "(&o)", &path);
+
+	DBG("connection %s", path);
+
+	if (g_hash_table_remove(vpn->connections, path) == TRUE)
+		update_routes(vpn);
+}
+
+static void property_changed_signal_cb(GDBusConnection *connection,
+					const gchar *sender_name,
+					const gchar *object_path,
+					const gchar *interface_name,
+					const gchar *signal_name,
+					GVariant *parameters,
+					gpointer user_data)
+{
+	struct connman_vpn *vpn = user_data;
+	struct vpn_connection *conn;
+	GVariant *value;
+	const char *key;
+
+	conn = g_hash_table_lookup(vpn->connections, object_path);
+	if (conn == NULL)
+		return;
+
+	g_variant_get(parameters, "(&sv)", &key, &value);
+
+	connection_update(conn, key, value);
+	update_routes(vpn);
+
+	g_variant_unref(value);
+}
+
+static void vpn_started(GDBusConnection *conn, const gchar *name,
+			const gchar *name_owner, void *user_data)
+{
+	struct connman_vpn *vpn = user_data;
+
+	DBG("connection %p vpn %p", conn, vpn);
+
+	get_connections(vpn);
+}
+
+static void vpn_stopped(GDBusConnection *conn, const gchar *name,
+			void *user_data)
+{
+	struct connman_vpn *vpn = user_data;
+
+	DBG("connection %p vpn %p", conn, vpn);
+
+	if (vpn->pending != NULL) {
+		g_cancellable_cancel(vpn->pending);
+		g_object_unref(vpn->pending);
+		vpn->pending = NULL;
+	}
+
+	g_hash_table_remove_all(vpn->connections);
+	update_routes(vpn);
+}
+
+struct connman_vpn *connman_vpn_init(connman_vpn_changed_cb changed_cb,
+					void *user_data)
+{
+	struct connman_vpn *vpn;
+
+	DBG("");
+
+	vpn = g_try_malloc0(sizeof(struct connman_vpn));
+	if (vpn == NULL)
+		return NULL;
+
+	vpn->connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, NULL);
+	vpn->changed_cb = changed_cb;
+	vpn->user_data = user_data;
+	vpn->connections = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, connection_free);
+	vpn->blocked = routes_new();
+	vpn->allowed = routes_new();
+	vpn->local = routes_new();
+
+	vpn->connection_added_watch =
+		g_dbus_connection_signal_subscribe(vpn->connection,
+						VPN_DBUS_NAME,
+						VPN_MANAGER_INTERFACE,
+						"ConnectionAdded",
+						VPN_MANAGER_PATH,
+						NULL,
+						G_DBUS_SIGNAL_FLAGS_NONE,
+						connection_added_signal_cb,
+						vpn,
+						NULL);
+	if (vpn->connection_added_watch == 0)
+		goto error;
+
+	vpn->connection_removed_watch =
+		g_dbus_connection_signal_subscribe(vpn->connection,
+						VPN_DBUS_NAME,
+						VPN_MANAGER_INTERFACE,
+						"ConnectionRemoved",
+						VPN_MANAGER_PATH,
+						NULL,
+						G_DBUS_SIGNAL_FLAGS_NONE,
+						connection_removed_signal_cb,
+						vpn,
+						NULL);
+	if (vpn->connection_removed_watch == 0)
+		goto error;
+
+	vpn->property_changed_watch =
+		g_dbus_connection_signal_subscribe(vpn->connection,
+						VPN_DBUS_NAME,
+						VPN_CONNECTION_INTERFACE,
+						"PropertyChanged",
+						NULL,
+						NULL,
+						G_DBUS_SIGNAL_FLAGS_NONE,
+						property_changed_signal_cb,
+						vpn,
+						NULL);
+	if (vpn->property_changed_watch == 0)
+		goto error;
+
+	/* The connections are fetched once the VPN daemon is seen */
+	vpn->vpn_watch = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
+					VPN_DBUS_NAME,
+					G_BUS_NAME_WATCHER_FLAGS_NONE,
+					vpn_started,
+					vpn_stopped,
+					vpn,
+					NULL);
+	if (vpn->vpn_watch == 0)
+		goto error;
+
+	return vpn;
+
+error:
+	DBG("Cannot initialize vpn");
+	connman_vpn_cleanup(vpn);
+	return NULL;
+}
+
+void connman_vpn_cleanup(struct connman_vpn *vpn)
+{
+	if (vpn == NULL)
+		return;
+
+	DBG("");
+
+	vpn->changed_cb = NULL;
+
+	if (vpn->pending != NULL) {
+		g_cancellable_cancel(vpn->pending);
+		g_object_unref(vpn->pending);
+		vpn->pending = NULL;
+	}
+
+	if (vpn->vpn_watch != 0) {
+		g_bus_unwatch_name(vpn->vpn_watch);
+		vpn->vpn_watch = 0;
+	}
+
+	if (vpn->property_changed_watch != 0) {
+		g_dbus_connection_signal_unsubscribe(vpn->connection,
+					vpn->property_changed_watch);
+		vpn->property_changed_watch = 0;
+	}
+
+	if (vpn->connection_removed_watch != 0) {
+		g_dbus_connection_signal_unsubscribe(vpn->connection,
+					vpn->connection_removed_watch);
+		vpn->connection_removed_watch = 0;
+	}
+
+	if (vpn->connection_added_watch != 0) {
+		g_dbus_connection_signal_unsubscribe(vpn->connection,
+					vpn->connection_added_watch);
+		vpn->connection_added_watch = 0;
+	}
+
+	g_object_unref(vpn->connection);
+
+	g_hash_table_destroy(vpn->connections);
+	g_array_free(vpn->blocked, TRUE);
+	g_array_free(vpn->allowed, TRUE);
+	g_array_free(vpn->local, TRUE);
+
+	vpn->user_data = NULL;
+
+	g_free(vpn);
+}
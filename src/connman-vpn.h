@@ -0,0 +1,60 @@
+/*
+ *
+ *  Network Monitor for Connection Manager
+ *
+ *  Copyright (C) 2012  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License version 2.1,
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+typedef void (*connman_vpn_changed_cb)(void *user_data);
+
+struct connman_vpn;
+
+/*
+ * A netmask or a prefix length as a prefix length, -EINVAL if it is
+ * neither or the mask is not contiguous.
+ */
+int connman_netmask2prefix(const char *netmask);
+
+struct connman_vpn *connman_vpn_init(connman_vpn_changed_cb changed_cb,
+					void *user_data);
+
+void connman_vpn_cleanup(struct connman_vpn *vpn);
+
+/*
+ * Networks of the default service as address/netmask or address/prefix
+ * length, hosts on them are never considered blocked. Either may be NULL.
+ */
+void connman_vpn_set_local_networks(struct connman_vpn *vpn,
+					const char *ipv4, const char *ipv6);
+
+/*
+ * Returns FALSE only if every address of the connectable is routed
+ * through a VPN that is not connected.
+ */
+gboolean connman_vpn_can_reach(struct connman_vpn *vpn,
+				GSocketConnectable *connectable,
+				GCancellable *cancellable);
+
+/* Resolves in the thread default context, the vpn has to outlive it */
+void connman_vpn_can_reach_async(struct connman_vpn *vpn,
+				GSocketConnectable *connectable,
+				GCancellable *cancellable,
+				GAsyncReadyCallback callback,
+				gpointer user_data);
+gboolean connman_vpn_can_reach_finish(struct connman_vpn *vpn,
+					GAsyncResult *result,
+					GError **error);
@@ -0,0 +1,116 @@
+/*
+ *
+ *  Network Monitor for Connection Manager
+ *
+ *  Copyright (C) 2012  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+
+#define LOGIND_DBUS_NAME "org.freedesktop.login1"
+#define LOGIND_PATH "/org/freedesktop/login1"
+#define LOGIND_INTERFACE "org.freedesktop.login1.Manager"
+
+/*
+ * Pretends to be logind on the system bus and sends PrepareForSleep
+ * around a fake suspend. Meant to be run on a private bus, see
+ * run-test-suspend.
+ */
+
+static gboolean prepare_for_sleep(GDBusConnection *connection,
+							gboolean start)
+{
+	GError *error = NULL;
+
+	g_print("%s\n", start ? "Suspending" : "Resuming");
+
+	if (g_dbus_connection_emit_signal(connection, NULL, LOGIND_PATH,
+					LOGIND_INTERFACE, "PrepareForSleep",
+					g_variant_new("(b)", start),
+					&error) == FALSE) {
+		g_print("Cannot send PrepareForSleep: %s\n", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	return g_dbus_connection_flush_sync(connection, NULL, NULL);
+}
+
+int main(int argc, char **argv)
+{
+	GDBusConnection *connection;
+	GVariant *reply;
+	GError *error = NULL;
+	unsigned int asleep = 2;
+	guint32 result;
+
+	g_type_init();
+
+	if (argc > 1 && strcmp(argv[1], "-h") == 0) {
+		g_print("Usage: %s [<seconds asleep>]\n", argv[0]);
+		exit(-1);
+	} else if (argc > 1)
+		asleep = atoi(argv[1]);
+
+	connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (connection == NULL) {
+		g_print("Cannot connect to the system bus: %s\n",
+							error->message);
+		g_error_free(error);
+		exit(1);
+	}
+
+	/* DBUS_NAME_FLAG_DO_NOT_QUEUE */
+	reply = g_dbus_connection_call_sync(connection, "org.freedesktop.DBus",
+					"/org/freedesktop/DBus",
+					"org.freedesktop.DBus", "RequestName",
+					g_variant_new("(su)", LOGIND_DBUS_NAME,
+									4),
+					G_VARIANT_TYPE("(u)"),
+					G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+					&error);
+	if (reply == NULL) {
+		g_print("Cannot own %s: %s\n", LOGIND_DBUS_NAME,
+							error->message);
+		g_error_free(error);
+		g_object_unref(connection);
+		exit(1);
+	}
+
+	g_variant_get(reply, "(u)", &result);
+	g_variant_unref(reply);
+
+	/* DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER */
+	if (result != 1) {
+		g_print("%s is already owned\n", LOGIND_DBUS_NAME);
+		g_object_unref(connection);
+		exit(1);
+	}
+
+	if (prepare_for_sleep(connection, TRUE) == TRUE) {
+		sleep(asleep);
+		prepare_for_sleep(connection, FALSE);
+	}
+
+	g_object_unref(connection);
+
+	return 0;
+}
@@ -28,25 +28,16 @@
 static unsigned int __terminated = 0;
 static GMainLoop *loop;
 
-static gboolean check_host(gpointer data)
+static void check_host_callback(GObject *source_object, GAsyncResult *res,
+							gpointer user_data)
 {
-	GNetworkMonitor *monitor;
-	GSocketConnectable *addr;
-	GCancellable *cancellable;
 	GError *error = NULL;
-	const char *host = data;
+	char *host = user_data;
 	gboolean reachable;
 
-	monitor =  g_network_monitor_get_default();
-
-	addr = g_network_address_new(host, 80);
-
-	cancellable = g_cancellable_new();
-
-	reachable = g_network_monitor_can_reach(monitor,
-						addr,
-						cancellable,
-						&error);
+	reachable = g_network_monitor_can_reach_finish(
+					G_NETWORK_MONITOR(source_object),
+					res, &error);
 
 	g_print("Host %s is %sreachable\n", host, reachable ? "" : "not ");
 	if (error != NULL) {
@@ -54,6 +45,29 @@ static gboolean check_host(gpointer data)
 		g_error_free(error);
 	}
 
+	g_free(host);
+}
+
+static gboolean check_host(gpointer data)
+{
+	GNetworkMonitor *monitor;
+	GSocketConnectable *addr;
+	const char *host = data;
+
+	monitor =  g_network_monitor_get_default();
+
+	addr = g_network_address_parse(host, 80, NULL);
+	if (addr == NULL) {
+		g_print("Invalid host %s\n", host);
+		return FALSE;
+	}
+
+	/* Probing must not block the main loop */
+	g_network_monitor_can_reach_async(monitor, addr, NULL,
+					check_host_callback, g_strdup(host));
+
+	g_object_unref(addr);
+
 	return FALSE;
 }
 
@@ -66,6 +80,32 @@ watch_network_changed(GNetworkMonitor * monitor,
 	g_timeout_add_seconds(0, check_host, user_data);
 }
 
+static void
+watch_link_quality(GObject *object, GParamSpec *pspec, gpointer user_data)
+{
+	GEnumClass *klass;
+	GEnumValue *value;
+	gint quality, strength;
+
+	g_object_get(object, "link-quality", &quality,
+			"signal-strength", &strength, NULL);
+
+	klass = g_type_class_ref(G_PARAM_SPEC_VALUE_TYPE(pspec));
+	value = g_enum_get_value(klass, quality);
+
+	g_print("Link quality is %s (strength %d)\n",
+			value ? value->value_nick : "invalid", strength);
+
+	g_type_class_unref(klass);
+}
+
+static void
+watch_default_service(GNetworkMonitor *monitor, const char *service,
+			gpointer user_data)
+{
+	g_print("Default service is %s\n", service ? service : "none");
+}
+
 static gboolean signal_handler(GIOChannel *channel, GIOCondition cond,
 							gpointer user_data)
 {
@@ -139,12 +179,20 @@ int main(int argc, char **argv)
 	GNetworkMonitor *monitor;
 	gboolean available;
 	const char *host = "www.connman.net";
+	guint probe_timeout = 0;
 	guint signal;
 
 	g_type_init();
 
+	if (argc > 2 && strcmp(argv[1], "-p") == 0) {
+		probe_timeout = atoi(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+
 	if (argc > 1 && strcmp(argv[1], "-h") == 0) {
-		g_print("Usage: %s [<hostname>]\n", argv[0]);
+		g_print("Usage: %s [-p <probe timeout ms>] "
+			"[<hostname>[:<port>]]\n", argv[0]);
 		exit(-1);
 	} else if (argc > 1)
 		host = argv[1];
@@ -154,9 +202,24 @@ int main(int argc, char **argv)
 	g_print("Monitoring via %s\n",
 		g_type_name_from_instance((GTypeInstance *) monitor));
 
+	if (probe_timeout > 0 &&
+			g_object_class_find_property(G_OBJECT_GET_CLASS(monitor),
+						"probe-timeout") != NULL)
+		g_object_set(monitor, "probe-timeout", probe_timeout, NULL);
+
 	g_signal_connect(monitor, "network-changed",
 			G_CALLBACK(watch_network_changed), (gpointer)host);
 
+	if (g_object_class_find_property(G_OBJECT_GET_CLASS(monitor),
+						"link-quality") != NULL)
+		g_signal_connect(monitor, "notify::link-quality",
+				G_CALLBACK(watch_link_quality), NULL);
+
+	if (g_signal_lookup("default-service-changed",
+				G_OBJECT_TYPE(monitor)) != 0)
+		g_signal_connect(monitor, "default-service-changed",
+				G_CALLBACK(watch_default_service), NULL);
+
 	available = g_network_monitor_get_network_available(monitor);
 	g_print("Initial network availibility is %s\n",
 		available ? "yes" : "no");